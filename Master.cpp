@@ -0,0 +1,191 @@
+#include "Master.hpp"
+#include "Server.hpp"
+#include "ReactorPool.hpp"
+#include <csignal>
+#include <sys/wait.h>
+#ifdef __linux__
+# include <sched.h>
+#endif
+
+// a worker exits with this when it cannot even start listening: respawning would not help
+#define WORKER_START_FAILED 2
+
+Master::Master(const std::vector<ServerConfig>& servers, const GlobalConfig& global)
+: servers(servers), global(global), workers(global.worker_processes, -1)
+{}
+
+Master::~Master() {}
+
+/*
+	worker_cpu_affinity auto: worker N runs on CPU N (mod online CPUs)
+*/
+void Master::pinToCpu(size_t slot)
+{
+#ifdef __linux__
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus <= 0)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(slot % cpus, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		perror("sched_setaffinity");
+#else
+	(void)slot;
+#endif
+}
+
+// Child side of fork(): never returns
+void Master::runWorker(size_t slot)
+{
+	if (global.worker_cpu_affinity)
+		pinToCpu(slot);
+
+	if (global.reactor_threads > 0)
+	{
+		ReactorPool pool(servers, global);
+		exit(pool.run() == 0 ? 0 : WORKER_START_FAILED);
+	}
+	Server server(0, servers[0].root, servers, global);
+	if (!server.start())
+		exit(WORKER_START_FAILED);
+	std::cout << "Worker " << slot << " (pid " << getpid() << ") started" << std::endl;
+	server.run();
+	exit(0);
+}
+
+bool Master::spawnWorker(size_t slot)
+{
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		perror("fork");
+		return false;
+	}
+	if (pid == 0)
+		runWorker(slot);
+	workers[slot] = pid;
+	return true;
+}
+
+size_t Master::findSlot(pid_t pid) const
+{
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (workers[i] == pid)
+			return i;
+	}
+	return workers.size();
+}
+
+bool Master::bindUnixListeners()
+{
+	for (size_t i = 0; i < servers.size(); ++i)
+	{
+		for (size_t j = 0; j < servers[i].listens.size(); ++j)
+		{
+			ListenAddress &listen = servers[i].listens[j];
+			if (!listen.isUnix())
+				continue;
+			listen.fd = Server::bindUnixSocket(listen);
+			if (listen.fd < 0)
+			{
+				std::cerr << "Failed to create listening socket on " << listen.name() << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void Master::closeUnixListeners()
+{
+	for (size_t i = 0; i < servers.size(); ++i)
+	{
+		for (size_t j = 0; j < servers[i].listens.size(); ++j)
+		{
+			ListenAddress &listen = servers[i].listens[j];
+			if (listen.fd < 0)
+				continue;
+			close(listen.fd);
+			unlink(listen.unix_path.c_str());
+			listen.fd = -1;
+		}
+	}
+}
+
+// Forward the shutdown to every worker and reap them
+void Master::stopWorkers()
+{
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (workers[i] > 0)
+			kill(workers[i], SIGTERM);
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (workers[i] > 0)
+		{
+			int status;
+			waitpid(workers[i], &status, 0);
+			workers[i] = -1;
+		}
+	}
+}
+
+int Master::run()
+{
+	setupSignalHandler();
+
+	if (!bindUnixListeners())
+	{
+		closeUnixListeners();
+		return 1;
+	}
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (!spawnWorker(i))
+		{
+			stopWorkers();
+			closeUnixListeners();
+			return 1;
+		}
+	}
+	std::cout << "Master " << getpid() << " running " << workers.size() << " workers" << std::endl;
+
+	int exit_code = 0;
+	while (g_running)
+	{
+		int status;
+		pid_t pid = waitpid(-1, &status, WNOHANG);
+		if (pid <= 0)
+		{
+			usleep(100000); // 100ms, same cadence as the CGI child polling
+			continue;
+		}
+		size_t slot = findSlot(pid);
+		if (slot == workers.size())
+			continue; // not one of ours
+		workers[slot] = -1;
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == WORKER_START_FAILED)
+		{
+			std::cerr << "Worker " << slot << " could not start listening, shutting down" << std::endl;
+			exit_code = 1;
+			break;
+		}
+		if (WIFSIGNALED(status))
+			std::cerr << "Worker " << slot << " (pid " << pid << ") killed by signal " << WTERMSIG(status) << ", respawning" << std::endl;
+		else
+			std::cerr << "Worker " << slot << " (pid " << pid << ") exited with " << WEXITSTATUS(status) << ", respawning" << std::endl;
+		if (!spawnWorker(slot))
+		{
+			exit_code = 1;
+			break;
+		}
+	}
+	stopWorkers();
+	closeUnixListeners();
+	std::cout << "Master shut down gracefully" << std::endl;
+	return exit_code;
+}
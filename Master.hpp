@@ -0,0 +1,42 @@
+#ifndef MASTER_HPP
+# define MASTER_HPP
+
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include "config_files/config.hpp"
+
+/*
+	Master/worker mode (worker_processes > 1).
+	The master only forks and supervises: every worker builds its own Server,
+	binds its own SO_REUSEPORT listeners and runs its own event loop, so the
+	kernel spreads new connections across workers.
+	Unix sockets cannot be bound twice: the master binds those before forking
+	and every worker accepts from the inherited socket.
+*/
+class Master
+{
+	private:
+		std::vector<ServerConfig> servers; // own copy: carries the inherited unix listener fds
+		const GlobalConfig& global;
+		std::vector<pid_t> workers; // pid per worker slot, -1 when not running
+
+		Master(const Master &other);
+		Master &operator=(const Master &other);
+
+		bool spawnWorker(size_t slot);
+		void runWorker(size_t slot);
+		void pinToCpu(size_t slot);
+		size_t findSlot(pid_t pid) const;
+		void stopWorkers();
+		bool bindUnixListeners();
+		void closeUnixListeners();
+
+	public:
+		Master(const std::vector<ServerConfig>& servers, const GlobalConfig& global);
+		~Master();
+
+		int run();
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "ReactorPool.hpp"
+#include <csignal>
+#include <stdint.h>
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
+
+#define REACTOR_INBOX_SIZE 4096
+
+ReactorPool::Reactor::Reactor()
+: server(NULL), inbox(REACTOR_INBOX_SIZE), wake_fd(-1), started(false)
+{}
+
+ReactorPool::ReactorPool(const std::vector<ServerConfig>& servers, const GlobalConfig& global)
+: servers(servers), global(global), next(0)
+{}
+
+ReactorPool::~ReactorPool()
+{
+	for (size_t i = 0; i < reactors.size(); ++i)
+	{
+		int fd;
+		// fds queued but never picked up
+		while (reactors[i]->inbox.pop(fd))
+			close(fd);
+		delete reactors[i]->server;
+		if (reactors[i]->wake_fd >= 0)
+			close(reactors[i]->wake_fd);
+		delete reactors[i];
+	}
+}
+
+void *ReactorPool::reactorMain(void *arg)
+{
+	Reactor *reactor = static_cast<Reactor*>(arg);
+	// SIGINT/SIGTERM go to the acceptor thread, which then wakes us up
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+	reactor->server->run();
+	return NULL;
+}
+
+void ReactorPool::wake(Reactor *reactor)
+{
+	uint64_t one = 1;
+	ssize_t n = write(reactor->wake_fd, &one, sizeof(one));
+	(void)n; // counter saturation only means a wakeup is already pending
+}
+
+bool ReactorPool::startReactors()
+{
+#ifdef __linux__
+	for (int i = 0; i < global.reactor_threads; ++i)
+	{
+		Reactor *reactor = new Reactor();
+		reactors.push_back(reactor);
+		reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (reactor->wake_fd < 0)
+		{
+			perror("eventfd");
+			return false;
+		}
+		reactor->server = new Server(0, servers[0].root, servers, global);
+		reactor->server->attachInbox(&reactor->inbox, reactor->wake_fd);
+		if (pthread_create(&reactor->thread, NULL, reactorMain, reactor) != 0)
+		{
+			std::cerr << "Failed to start reactor thread " << i << std::endl;
+			return false;
+		}
+		reactor->started = true;
+	}
+	return true;
+#else
+	std::cerr << "reactor_threads needs eventfd (Linux only)" << std::endl;
+	return false;
+#endif
+}
+
+void ReactorPool::stopReactors()
+{
+	g_running = false;
+	for (size_t i = 0; i < reactors.size(); ++i)
+	{
+		if (reactors[i]->started)
+			wake(reactors[i]);
+	}
+	for (size_t i = 0; i < reactors.size(); ++i)
+	{
+		if (reactors[i]->started)
+			pthread_join(reactors[i]->thread, NULL);
+		reactors[i]->started = false;
+	}
+}
+
+/*
+	Acceptor side: runs on the acceptor thread only, so it is each queue's single producer.
+	A full queue moves on to the next reactor; if every queue is full the fd is refused.
+*/
+bool ReactorPool::dispatch(int client_fd)
+{
+	for (size_t tries = 0; tries < reactors.size(); ++tries)
+	{
+		Reactor *reactor = reactors[next];
+		next = (next + 1) % reactors.size();
+		if (reactor->inbox.push(client_fd))
+		{
+			wake(reactor);
+			return true;
+		}
+	}
+	std::cerr << "All reactor queues full, refusing fd " << client_fd << std::endl;
+	return false;
+}
+
+int ReactorPool::run()
+{
+	Server acceptor(0, servers[0].root, servers, global);
+	if (!acceptor.start())
+		return 1;
+	acceptor.setConnectionSink(this);
+	if (!startReactors())
+	{
+		stopReactors();
+		return 1;
+	}
+	std::cout << "Acceptor running with " << reactors.size() << " reactor threads" << std::endl;
+	acceptor.run();
+	stopReactors();
+	return 0;
+}
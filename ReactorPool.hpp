@@ -0,0 +1,51 @@
+#ifndef REACTORPOOL_HPP
+# define REACTORPOOL_HPP
+
+#include <vector>
+#include <pthread.h>
+#include "Server.hpp"
+
+/*
+	Threaded mode (reactor_threads > 0).
+	The calling thread is the acceptor: a Server that owns the listening sockets
+	and hands every accepted fd to one of N reactor threads, round-robin, through
+	a lock-free FdQueue plus an eventfd wakeup. Each reactor is a Server with its
+	own poll/epoll set and connection table; all of them read the same
+	ServerConfig vector, which nobody writes after startup.
+*/
+class ReactorPool: public ConnectionSink
+{
+	private:
+		struct Reactor
+		{
+			Server *server;
+			FdQueue inbox;
+			int wake_fd;
+			pthread_t thread;
+			bool started;
+
+			Reactor();
+		};
+
+		const std::vector<ServerConfig>& servers;
+		const GlobalConfig& global;
+		std::vector<Reactor*> reactors;
+		size_t next; // round-robin cursor
+
+		ReactorPool(const ReactorPool &other);
+		ReactorPool &operator=(const ReactorPool &other);
+
+		static void *reactorMain(void *arg);
+		bool startReactors();
+		void stopReactors();
+		void wake(Reactor *reactor);
+
+	public:
+		ReactorPool(const std::vector<ServerConfig>& servers, const GlobalConfig& global);
+		~ReactorPool();
+
+		bool dispatch(int client_fd);
+		int run();
+};
+
+#endif
@@ -1,5 +1,13 @@
 #include "Server.hpp"
+#include "http/http_cgi.hpp"
 #include <csignal>
+#include <cerrno>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <stdint.h>
 
 //volatile: tells the compiler not to optimize this variable away, because it might change unexpectedly
 volatile sig_atomic_t g_running = true;
@@ -49,249 +57,647 @@ void setupSignalHandler()
 	sa.sa_flags = 0;// no special behavior
 	sigaction(SIGINT, &sa, NULL);// attach handler for ctrl + c
 	sigaction(SIGTERM, &sa, NULL);// attach handler for kill pid
+	// writev/sendfile to a peer that went away must fail with -1, not kill us
+	signal(SIGPIPE, SIG_IGN);
 }
 
+Server::Connection::Connection()
+: send_inflight(false), close_after_write(false), lingering(false), linger_left(0), linger_until(0),
+  want_write(false), nopush(false), corked(false), read_size(READ_BYTES), io_used(0), io_tick(0),
+  in_use(false), phase(PHASE_HEADER), slot(0)
+{}
+
 /**
- * Remove a file descriptor at a give index from the set
+ * O(1) lookup of a client's record, NULL if fd is not an open client
  */
-void Server::removePfds(int i)
+Server::Connection *Server::findConnection(int fd)
 {
-	pfds.erase(pfds.begin() + i);
+	if (fd < 0 || static_cast<size_t>(fd) >= connections_.size() || !connections_[fd].in_use)
+		return NULL;
+	return &connections_[fd];
 }
 
 /**
- * Add a new file descriptor to the set
+ * Drain a ready listener: up to accept_batch connections per tick,
+ * so a burst is not served one poll round-trip per client
  */
-void Server::addPfds(int client_fd)
+void Server::addNewConnection(int listen_fd)
 {
-	struct pollfd pfd;
-	pfd.fd = client_fd;
-	pfd.events = POLLIN;// check ready to read
-	pfd.revents = 0;
-	pfds.push_back(pfd);
+	for (int i = 0; i < global_.accept_batch; ++i)
+	{
+		// cast it to a sockaddr pointer because of all the extra space it has for larger addresses
+		struct sockaddr_storage client_addr;
+		socklen_t addr_len = sizeof(client_addr);
+#ifdef SOCK_NONBLOCK
+		// accept and make the client non-blocking in one syscall
+		int client_fd = accept4(listen_fd, (struct sockaddr *)&client_addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+		int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &addr_len);
+		if (client_fd != -1)
+		{
+			int flags = fcntl(client_fd, F_GETFL, 0);
+			if (flags != -1)
+				fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+			fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+		}
+#endif
+		if (client_fd == -1)
+		{
+			// queue drained (or another worker won the race); anything else is worth a log
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+				perror("accept");
+			return;
+		}
+		acceptClient(client_fd);
+	}
 }
 
-void Server::addNewConnection(int listen_fd, std::map<int, HTTPRequest> &requestMap)
+/**
+ * Route a freshly accepted, non-blocking client to whichever loop serves it
+ */
+void Server::acceptClient(int client_fd)
 {
-	// cast it to a sockaddr pointer because of all the extra space it has for larger addresses
-	struct sockaddr_storage client_addr;
-	socklen_t addr_len = sizeof(client_addr);
-	// now accept an incoming connection
-	int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &addr_len);
+	// acceptor role: another event loop serves this client
+	if (sink_)
+	{
+		if (!sink_->dispatch(client_fd))
+			close(client_fd);
+		return;
+	}
+	registerClient(client_fd);
+}
 
-	if (client_fd == -1)
+/**
+ * Start serving an accepted, non-blocking client socket on this event loop
+ */
+void Server::registerClient(int client_fd)
+{
+	// Optional: leave blocking; poll() ensures readiness.
+	// If you switch to nonblocking, DO NOT inspect errno after send/read.
+	if (!poller_->watchClient(client_fd))// check ready to read (io_uring: start receiving)
 	{
-		perror("accept");
+		perror("poller add");
+		close(client_fd);
+		return;
 	}
-	else
+	// the kernel hands out the lowest free fd, so the table stays dense
+	if (static_cast<size_t>(client_fd) >= connections_.size())
+		connections_.resize(client_fd + 1);
+	Connection &conn = connections_[client_fd];
+	conn.request = HTTPRequest(client_fd);
+	conn.route = RouteContext();
+	conn.request.setHeaderLimits(global_.header_buffer_size,
+		global_.header_buffer_size * static_cast<size_t>(global_.header_buffers),
+		static_cast<size_t>(global_.max_request_headers));
+	conn.request.setBodyBuffer(global_.client_body_buffer_size, global_.client_body_temp_path);
+	setLocalAddress(client_fd, conn.request);
+	conn.outbox.clear();
+	conn.send_inflight = false;
+	conn.close_after_write = false;
+	conn.lingering = false;
+	conn.want_write = false;
+	conn.corked = false;
+	conn.read_size = READ_BYTES;
+	tuneClient(client_fd, conn);
+	conn.io_used = 0;
+	conn.in_use = true;
+	conn.slot = active_fds_.size();
+	active_fds_.push_back(client_fd);
+	// a new client gets client_header_timeout to send its first request
+	conn.phase = PHASE_HEADER;
+	timers_.schedule(client_fd, TimerHeap::nowMs() + global_.client_header_timeout * 1000LL);
+}
+
+/**
+ * Record which of our addresses the client connected to, for virtual host selection.
+ * An IPv4 client of a dual-stack [::] socket shows up as ::ffff:a.b.c.d and is stored as a.b.c.d,
+ * a unix socket client as "unix:/path" with port 0
+ */
+void Server::setLocalAddress(int client_fd, HTTPRequest &request)
+{
+	struct sockaddr_storage local;
+	socklen_t len = sizeof(local);
+	if (getsockname(client_fd, (struct sockaddr *)&local, &len) == -1)
+		return;
+	char buf[INET6_ADDRSTRLEN];
+	if (local.ss_family == AF_UNIX)
 	{
-		// make client non-blocking
-		int flags = fcntl(client_fd, F_GETFL, 0);
-		if (flags != -1) 
-			fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+		struct sockaddr_un *un = (struct sockaddr_un *)&local;
+		request.setLocalAddress(std::string("unix:") + un->sun_path, 0);
+	}
+	else if (local.ss_family == AF_INET)
+	{
+		struct sockaddr_in *in = (struct sockaddr_in *)&local;
+		if (inet_ntop(AF_INET, &in->sin_addr, buf, sizeof(buf)))
+			request.setLocalAddress(buf, ntohs(in->sin_port));
+	}
+	else if (local.ss_family == AF_INET6)
+	{
+		struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&local;
+		const char *ok;
+		if (IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr))
+			ok = inet_ntop(AF_INET, &in6->sin6_addr.s6_addr[12], buf, sizeof(buf));
+		else
+			ok = inet_ntop(AF_INET6, &in6->sin6_addr, buf, sizeof(buf));
+		if (ok)
+			request.setLocalAddress(buf, ntohs(in6->sin6_port));
+	}
+}
 
-		// Optional: leave blocking; poll() ensures readiness.
-		// If you switch to nonblocking, DO NOT inspect errno after send/read.
-		addPfds(client_fd);
-		requestMap[client_fd] = HTTPRequest(client_fd);// create new HTTPRequest if haven't
-		client_state_[client_fd] = ClientState();// init outbox
-		client_state_[client_fd].close_after_write = false;
-		last_activity[client_fd] = time(NULL);
+/**
+ * Per-connection socket options of the server the client connected to (the default
+ * server for its local address: no Host header yet). Done here rather than at accept()
+ * so the batch, io_uring and reactor accept paths all get it.
+ */
+void Server::tuneClient(int client_fd, Connection &conn)
+{
+	const ServerConfig *cfg = findServerConfig(conn.request, servers);
+	bool tcp = conn.request.getLocalPort() != 0; // unix sockets have neither Nagle nor corking
+	conn.nopush = tcp && cfg && cfg->tcp_nopush;
+	if (tcp && cfg && cfg->tcp_nodelay)
+	{
+		int on = 1;
+		setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
 	}
 }
 
-bool Server::isListeningSocket(int fd)
+/**
+ * tcp_nopush: hold partial segments while headers and a sendfile body are queued,
+ * so the headers share the first segment with the file instead of leaving alone
+ */
+void Server::setCork(int fd, Connection &conn, bool on)
 {
-	for (size_t i = 0; i < listening_sockets.size(); i++)
+	int value = on ? 1 : 0;
+#if defined(TCP_CORK)
+	setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+#elif defined(TCP_NOPUSH)
+	setsockopt(fd, IPPROTO_TCP, TCP_NOPUSH, &value, sizeof(value));
+#endif
+	conn.corked = on;
+}
+
+/**
+ * One flush of the outbox, corked around file responses when tcp_nopush is on.
+ * Uncorking once the outbox is empty pushes out the last partial segment.
+ */
+ssize_t Server::sendQueued(int fd, Connection &conn)
+{
+	if (conn.nopush && !conn.corked && conn.outbox.hasFile())
+		setCork(fd, conn, true);
+	ssize_t n = conn.outbox.flush(fd);
+	if (conn.corked && conn.outbox.empty())
+		setCork(fd, conn, false);
+	return n;
+}
+
+/**
+ * Reactor mode: take every fd the acceptor queued for us
+ */
+void Server::drainInbox()
+{
+	uint64_t count;
+	// reset the eventfd counter, one read covers any number of pushes
+	ssize_t n = read(wake_fd_, &count, sizeof(count));
+	(void)n;
+	int client_fd;
+	while (inbox_->pop(client_fd))
+		registerClient(client_fd);
+}
+
+/**
+ * Drop a client: leave the poll set, close the socket and forget all its state
+ */
+void Server::closeConnection(int fd)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	poller_->remove(fd);
+	timers_.cancel(fd);
+	close(fd);
+
+	// swap-and-pop: move the last active fd into our slot
+	int moved = active_fds_.back();
+	active_fds_[conn->slot] = moved;
+	connections_[moved].slot = conn->slot;
+	active_fds_.pop_back();
+
+	conn->in_use = false;
+	conn->request = HTTPRequest();
+	conn->outbox.clear(); // frees its buffers and closes queued files
+	conn->send_inflight = false;
+}
+
+/*
+	The last response is out and the connection was marked to close. A client whose
+	request was refused before all of it was read may still be sending, and closing
+	now would answer those bytes with a RST that can discard the response before the
+	client read it. Such a connection only shuts down its sending side, then reads and
+	drops input until the client closes, lingering_timeout passes without input,
+	lingering_time passes or LINGER_DISCARD_MAX bytes were dropped.
+*/
+void Server::closeAfterWrite(int fd)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	if (!conn->request.hasError() || shutdown(fd, SHUT_WR) < 0)
 	{
-		if (listening_sockets[i] == fd)// socket is our listening socket
-		{
-			return true;
-		}
+		closeConnection(fd);
+		return;
 	}
-	return false;
+	disableWrite(fd);
+	long long now = TimerHeap::nowMs();
+	conn->lingering = true;
+	conn->linger_left = LINGER_DISCARD_MAX;
+	conn->linger_until = now + global_.lingering_time * 1000LL;
+	conn->phase = PHASE_LINGER;
+	timers_.schedule(fd, std::min(now + global_.lingering_timeout * 1000LL, conn->linger_until));
 }
 
-void Server::checkTimeOut(std::map<int, HTTPRequest> request_map)
+/*
+	Input on a lingering connection: len bytes were read (<= 0: closed or failed)
+*/
+void Server::discardLingering(int fd, ssize_t len)
 {
-	time_t current_time = time(NULL);
-	for (size_t i = 0; i < pfds.size(); i++)
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	long long now = TimerHeap::nowMs();
+	if (len <= 0 || static_cast<size_t>(len) >= conn->linger_left || now >= conn->linger_until)
 	{
-		int fd = pfds[i].fd;
-		
-		// Skip listening sockets for timeout checking
-		if (isListeningSocket(fd))
+		closeConnection(fd);
+		return;
+	}
+	conn->linger_left -= static_cast<size_t>(len);
+	timers_.schedule(fd, std::min(now + global_.lingering_timeout * 1000LL, conn->linger_until));
+}
+
+bool Server::isListeningSocket(int fd) const
+{
+	return fd >= 0 && static_cast<size_t>(fd) < is_listener_.size() && is_listener_[fd];
+}
+
+/*
+	Expire every client whose deadline has passed, O(expired) per tick.
+	Header/body timeouts answer 408, an idle keep-alive or stalled send just closes.
+*/
+void Server::checkTimeOut()
+{
+	long long now = TimerHeap::nowMs();
+	int fd;
+	while ((fd = timers_.popExpired(now)) >= 0)
+	{
+		Connection *conn = findConnection(fd);
+		if (!conn)
 			continue;
-		
-		// If this file descriptor exists in my activity map and the client has been idle longer than the timeout, then close the connection.
-		if (last_activity.count(fd) && (current_time - last_activity[fd] > timeout))
+		if (conn->phase == PHASE_HEADER || conn->phase == PHASE_BODY)
 		{
-			std::cout << "Timeout closing fd " << fd << " (idle for " << (current_time - last_activity[fd]) << "s)" << std::endl;
-			
+			std::cout << "Timeout closing fd " << fd << " ("
+				<< (conn->phase == PHASE_HEADER ? "header" : "body") << " read)" << std::endl;
 			// Send 408 timeout response
 			sendTimeoutResponse(fd);
-			
-			// Clean up
-			close(fd);
-			client_state_.erase(fd);
-			request_map.erase(fd);
-			last_activity.erase(fd);
-			removePfds(i);
-			--i; // Adjust index after removal
-			continue;
 		}
+		else
+		{
+			std::cout << "Timeout closing fd " << fd << " ("
+				<< (conn->phase == PHASE_IDLE ? "keep-alive idle"
+					: conn->phase == PHASE_LINGER ? "lingering close" : "send") << ")" << std::endl;
+		}
+		// Clean up
+		closeConnection(fd);
+	}
+}
+
+/*
+	Pick the deadline that matches where the client is and (re)arm it.
+	activity: bytes just moved, which restarts the body and send timers.
+	The header timer only starts when the phase is entered, so a client
+	trickling one byte at a time cannot keep a partial header alive.
+*/
+void Server::refreshTimer(int fd, bool activity)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn || conn->lingering)
+		return;
+	TimerPhase phase;
+	int seconds;
+	if (!conn->outbox.empty() || conn->send_inflight)
+	{
+		phase = PHASE_SEND;
+		seconds = global_.send_timeout;
+	}
+	else if (conn->request.isHeaderComplete())
+	{
+		phase = PHASE_BODY;
+		seconds = global_.client_body_timeout;
+	}
+	else if (conn->request.hasPendingData())
+	{
+		phase = PHASE_HEADER;
+		seconds = global_.client_header_timeout;
+	}
+	else
+	{
+		phase = PHASE_IDLE;
+		seconds = global_.keepalive_timeout;
+	}
+	if (phase == conn->phase && !(activity && (phase == PHASE_BODY || phase == PHASE_SEND)))
+		return;
+	conn->phase = phase;
+	timers_.schedule(fd, TimerHeap::nowMs() + seconds * 1000LL);
+}
+
+/*
+	poll/epoll timeout: time left until the nearest deadline.
+	Capped so a signal landing just before the wait is still noticed promptly.
+*/
+int Server::nextTimeout() const
+{
+	const long long cap = 1000;
+	if (timers_.empty())
+		return static_cast<int>(cap);
+	long long left = timers_.nextDeadline() - TimerHeap::nowMs();
+	if (left < 0)
+		left = 0;
+	if (left > cap)
+		left = cap;
+	return static_cast<int>(left);
+}
+
+/*
+	Take one read or write from the connection's io_budget for this loop iteration.
+	false: budget spent, leave the fd for the next iteration (level-triggered, so
+	nothing is lost) and let the other clients have their turn.
+*/
+bool Server::chargeIo(Connection &conn)
+{
+	if (conn.io_tick != tick_)
+	{
+		conn.io_tick = tick_;
+		conn.io_used = 0;
+	}
+	if (conn.io_used >= global_.io_budget)
+		return false;
+	++conn.io_used;
+	return true;
+}
+
+/*
+	Send as much of the client's outbox as the socket takes right now.
+	Returns false if the connection was closed.
+*/
+bool Server::flushClient(int fd)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return false;
+	if (conn->lingering)
+		return true; // nothing more to send, reads are drained
+	// Nothing left to send, stop POLLOUT(send buffer empty)
+	if (conn->outbox.empty())
+	{
+		// close was asked for after everything queued had already gone out
+		if (conn->close_after_write)
+		{
+			closeAfterWrite(fd);
+			return false;
+		}
+		disableWrite(fd); // Remove POLLOUT event, nothing to write
+		return true;
+	}
+	if (!chargeIo(*conn))
+		return true;
+	// Try to send as much as possible in one go (one writev, or sendfile for a file)
+	ssize_t n = sendQueued(fd, *conn);
+	if (n <= 0)
+	{
+		// If send() failed (n <= 0), log and close the connection
+		// Do NOT inspect errno, just close and clean up
+		std::cerr << "send failed on fd " << fd << "\n";
+		closeConnection(fd);
+		return false;
+	}
+	// flush() already moved the cursor past the bytes that were sent
+	// If all data has been sent
+	if (conn->outbox.empty())
+	{
+		// If we want to close after sending (Connection close)
+		if (conn->close_after_write)
+		{
+			// Close the socket (or linger on it) and clean up all state
+			closeAfterWrite(fd);
+			return false;
+		}
+		// Otherwise, just stop POLLOUT and go back to read-only
+		disableWrite(fd);
+	}
+	// restart the send timer, or move on to keep-alive idle
+	refreshTimer(fd, true);
+	return true;
+}
+
+/*
+	Completion backend: hand what is queued to the kernel as one linked chain.
+	File ranges go one OUTPUT_FILE_WINDOW at a time; the rest, and responses
+	queued meanwhile, stay in the outbox for the next chain.
+*/
+void Server::submitSends(int fd)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn || conn->send_inflight || conn->outbox.empty())
+		return;
+	std::vector<std::string> buffers;
+	if (!conn->outbox.drainTo(buffers, OUTPUT_FILE_WINDOW) || !poller_->submitSend(fd, buffers))
+	{
+		std::cerr << "send failed on fd " << fd << "\n";
+		closeConnection(fd);
+		return;
+	}
+	conn->send_inflight = true;
+}
+
+/*
+	Completion backend: the accept, recv or send already happened, act on its result
+*/
+void Server::handleCompletion(const PollEvent &ev)
+{
+	int fd = ev.fd;
+	if (ev.kind == EVENT_ACCEPTED)
+	{
+		if (ev.result < 0)
+			std::cerr << "accept failed on fd " << fd << "\n";
+		else
+			acceptClient(static_cast<int>(ev.result));
+		return;
+	}
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	if (ev.kind == EVENT_RECEIVED)
+	{
+		receiveClientData(fd, ev.data, ev.result, servers, *this);
+		return;
+	}
+	if (ev.kind == EVENT_SEND_PROGRESS)
+	{
+		refreshTimer(fd, true); // bytes moved, restart send_timeout
+		return;
+	}
+	// EVENT_SENT
+	conn->send_inflight = false;
+	if (ev.result < 0)
+	{
+		std::cerr << "send failed on fd " << fd << "\n";
+		closeConnection(fd);
+		return;
+	}
+	if (!conn->outbox.empty())
+		submitSends(fd);
+	else if (conn->close_after_write)
+	{
+		closeAfterWrite(fd);
+		return;
+	}
+	refreshTimer(fd, true);
+}
+
+/*
+	Dispatch one ready fd, whichever backend reported it
+*/
+void Server::handleEvent(const PollEvent &ev)
+{
+	int fd = ev.fd;
+	short revents = ev.events;
+	// fd was removed after the backend collected this completion
+	if (poller_->isStale(ev))
+	{
+		if (ev.kind == EVENT_ACCEPTED && ev.result >= 0)
+			close(static_cast<int>(ev.result));
+		return;
+	}
+	if (ev.kind != EVENT_READY)
+	{
+		handleCompletion(ev);
+		return;
+	}
+	if (inbox_ && fd == wake_fd_)
+	{
+		drainInbox();
+		return;
+	}
+	if (isListeningSocket(fd))
+	{
+		// if is listener, it is a new connection
+		if (revents & POLLIN)
+			addNewConnection(fd);// accept a new connection
+		return;
+	}
+	// fd was closed earlier in this tick (its event is stale)
+	if (!findConnection(fd))
+		return;
+
+	// Handle error-y revents (prevents “mystery hangs”)
+	// POLLERR: An error has occurred on this socket.
+	// POLLNVAL: Invalid request: fd not open (only returned in revents; ignored in events)
+	if (revents & (POLLERR | POLLNVAL))
+	{
+		closeConnection(fd);
+		return;
+	}
+
+	// Write and read in the same tick, each charged to the client's io_budget
+	// POLLOUT: Alert me when I can send() data to this socket without blocking.
+	if (revents & POLLOUT)
+	{
+		if (!flushClient(fd))
+			return;
+	}
+
+	// check if someone ready to read (or closed)
+	// POLLIN: There is data to read
+	// POLLHUP: The remote side of the connection hung up.
+	if (revents & (POLLIN | POLLHUP))
+	{
+		Connection *conn = findConnection(fd);
+		if (conn && chargeIo(*conn))
+			readClientData(fd, servers, *this);
 	}
 }
 
 // Main loop
 void Server::run()
 {
-	std::map<int, HTTPRequest> request_map;
+	std::vector<PollEvent> ready;
 	setupSignalHandler();
 
-	std::cout << "waiting for connections" << std::endl;
+	std::cout << "waiting for connections (" << poller_->name() << ")" << std::endl;
 	while (g_running)
 	{
-		int ready_fd = poll(pfds.data(), pfds.size(), 100);
+		int ready_fd = poller_->wait(ready, nextTimeout());
+		++tick_;
 		if (ready_fd < 0)
 		{
 			perror("poll failed");
 			break;
 		}
-		checkTimeOut(request_map);
-		for (size_t i = 0; i < pfds.size(); i++)
+		for (size_t i = 0; i < ready.size(); i++)
 		{
-			// Handle error-y revents (prevents “mystery hangs”)
-			// POLLERR: An error has occurred on this socket.
-			// POLLNVAL: Invalid request: fd not open (only returned in revents; ignored in events)
-			if (pfds[i].revents & (POLLERR | POLLNVAL))
-			{
-				int fd = pfds[i].fd;
-				close(fd);
-				client_state_.erase(fd);
-				request_map.erase(fd);
-				last_activity.erase(fd);
-				pfds.erase(pfds.begin() + i);
-				--i;
-				continue;
-			}
-
-			// Handle exactly one write OR one read per client per poll tick
-			// POLLOUT: Alert me when I can send() data to this socket without blocking.
-			if (pfds[i].revents & POLLOUT)
-			{
-				int fd = pfds[i].fd; // Get the file descriptor for this client
-				// Find the client state for this fd
-				std::map<int, ClientState>::iterator csit = client_state_.find(fd);
-				// If we have no state for this fd, or nothing left to send, stop POLLOUT(send buffer empty)
-				if (csit == client_state_.end() || csit->second.outbox.empty())
-				{
-					disableWrite(fd); // Remove POLLOUT event, nothing to write
-				}
-				else
-				{
-					// Get the data buffer to send
-					// second: the value
-					const std::string &buf = csit->second.outbox;
-					// Try to send as much as possible in one go
-					ssize_t n = send(fd, buf.data(), buf.size(), 0);
-					if (n > 0)
-					{
-						// Remove the bytes that were successfully sent
-						csit->second.outbox.erase(0, static_cast<size_t>(n));
-						// If all data has been sent
-						if (csit->second.outbox.empty())
-						{
-							// If we want to close after sending (Connection close)
-							if (csit->second.close_after_write)
-							{
-								// Close the socket and clean up all state
-								close(fd);
-								client_state_.erase(fd);
-								request_map.erase(fd);
-								last_activity.erase(fd);
-								pfds.erase(pfds.begin() + i);
-								--i; // Adjust index after erase
-								// Don't touch pfds[i].revents after erase
-								continue;
-							}
-							// Otherwise, just stop POLLOUT and go back to read-only
-							disableWrite(fd);
-						}
-					}
-					else
-					{
-						// If send() failed (n <= 0), log and close the connection
-						// Do NOT inspect errno, just close and clean up
-						std::cerr << "send failed on fd " << fd << "\n";
-						close(fd);
-						client_state_.erase(fd);
-						request_map.erase(fd);
-						last_activity.erase(fd);
-						pfds.erase(pfds.begin() + i);
-						--i;
-					}
-				}
-				// Reset revents for this pollfd (we handled the event)
-				pfds[i].revents = 0;
-				// Update last activity time for this client
-				last_activity[fd] = time(NULL);
-				// Only one write OR one read per poll tick, so continue
-				continue;
-			}
-
-			// check if someone ready to read (or closed)
-			// POLLIN: There is data to read
-			// POLLHUP: The remote side of the connection hung up.
-			if (pfds[i].revents & (POLLIN | POLLHUP))
-			{
-				// if is listener, it is a new connection
-				if (isListeningSocket(pfds[i].fd))
-				{
-					addNewConnection(pfds[i].fd, request_map);// accept a new connection
-				}
-				// just a regular client
-				else
-				{
-					readClientData(pfds[i].fd, request_map, pfds, i, servers, *this);
-				}
-			}
-			pfds[i].revents = 0;
+			handleEvent(ready[i]);
 		}
+		// after dispatch, so no ready event can refer to an fd closed here
+		checkTimeOut();
 	}
 	// Close all client connections
-	for (size_t i = 0; i < pfds.size(); i++)
+	while (!active_fds_.empty())
 	{
-		if (pfds[i].fd >= 0)
-		{
-			close(pfds[i].fd);
-		}
+		closeConnection(active_fds_.back());
+	}
+	for (size_t i = 0; i < listening_sockets.size(); i++)
+	{
+		poller_->remove(listening_sockets[i]);
+		close(listening_sockets[i]);
 	}
 
-	// Clear the pollfd vector
-	pfds.clear();
-	client_state_.clear();
-	last_activity.clear();
+	listening_sockets.clear();
+	is_listener_.clear();
+	connections_.clear();
 
 	std::cout << "Server shut down gracefully" << std::endl;
 }
 
-int Server::createListeningSocket(const std::string& port_str)
+int Server::createListeningSocket(const ListenAddress& addr, bool ipv6only)
 {
+	if (addr.isUnix())
+	{
+		// worker mode: the master bound it before fork, every worker shares that socket
+		int unix_fd = addr.fd;
+		if (unix_fd < 0)
+		{
+			unix_fd = bindUnixSocket(addr);
+			if (unix_fd < 0)
+				return -1;
+			unix_paths_.push_back(addr.unix_path); // ours to unlink on shutdown
+		}
+		registerListener(unix_fd);
+		return unix_fd;
+	}
 	int opt = 1;
 	int res;
 	// ai: pointer to addinfo,point to the head of a linked list(first node)
 	// ptr: traverse the linked list
 	struct addrinfo hints, *ai, *ptr;
+	std::ostringstream port_str;
+	port_str << addr.port;
 	
 	// get host info, make socket, and connect it
 	memset(&hints, 0, sizeof(hints));// make sure the struct is empty
-	hints.ai_family = AF_INET;       // use IPv4
+	hints.ai_family = AF_UNSPEC;     // IPv4 or IPv6, whichever addr.ip is
 	hints.ai_socktype = SOCK_STREAM; // TCP strream sockets
-	hints.ai_flags = AI_PASSIVE;// use my IP address
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;// the config already holds numeric addresses
 
 	// Allocate memory and create a new linked list of addrinfo
-	if ((res = getaddrinfo(NULL, port_str.c_str(), &hints, &ai)) != 0)
+	if ((res = getaddrinfo(addr.ip.c_str(), port_str.str().c_str(), &hints, &ai)) != 0)
 	{
 		fprintf(stderr, "server: %s\n", gai_strerror(res));
 		return -1;
@@ -314,8 +720,24 @@ int Server::createListeningSocket(const std::string& port_str)
 		
 		// set sockfd to allow multiple connection
 		setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int));
+#ifdef SO_REUSEPORT
+		// worker mode: every worker binds its own socket, the kernel balances between them
+		if (global_.worker_processes > 1)
+			setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int));
+#endif
+		// set before listen(): the window scale offered in the handshake depends on it
+		if (addr.rcvbuf > 0)
+			setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &addr.rcvbuf, sizeof(int));
+		if (addr.sndbuf > 0)
+			setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &addr.sndbuf, sizeof(int));
+		// [::] is dual-stack (also takes IPv4 clients) unless an IPv4 listen shares its port
+		if (ptr->ai_family == AF_INET6)
+		{
+			int v6only = ipv6only ? 1 : 0;
+			setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(int));
+		}
 		
-		// bind it to the port we passed in to getaddrinfo():
+		// bind it to the address we passed in to getaddrinfo():
 		if (bind(sockfd, ptr->ai_addr, ptr->ai_addrlen) < 0)
 		{
 			close(sockfd);
@@ -325,147 +747,325 @@ int Server::createListeningSocket(const std::string& port_str)
 		break;// connected successfully
 	}
 	
-	// looped off the end of the list with no connection
-	if (ptr == NULL)
-	{
-		return -1;
-	}
-	
 	// deallocate memory created by geraddrinfo
 	freeaddrinfo(ai);
 
+	// looped off the end of the list with no connection
 	if (sockfd < 0)
 	{
 		return -1;
 	}
 
 	// set sockfd up to be a server socket
-	if (listen(sockfd, 10) == -1)
+	if (listen(sockfd, addr.backlog) == -1)
 	{
 		perror("listen");
 		close(sockfd);
 		return -1;
 	}
+#ifdef TCP_DEFER_ACCEPT
+	// only report the connection once its first bytes arrived (or the header timeout passed)
+	if (addr.deferred)
+	{
+		int secs = global_.client_header_timeout;
+		if (setsockopt(sockfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(int)) == -1)
+			perror("setsockopt TCP_DEFER_ACCEPT");
+	}
+#endif
+#ifdef TCP_FASTOPEN
+	// accept data in the SYN from clients holding a cookie, saves a round trip
+	if (addr.fastopen > 0)
+	{
+		if (setsockopt(sockfd, IPPROTO_TCP, TCP_FASTOPEN, &addr.fastopen, sizeof(int)) == -1)
+			perror("setsockopt TCP_FASTOPEN");
+	}
+#endif
+	registerListener(sockfd);
+	return sockfd;
+}
 
+void Server::registerListener(int sockfd)
+{
 	// keep track of listening socket
 	listening_sockets.push_back(sockfd);
+	if (static_cast<size_t>(sockfd) >= is_listener_.size())
+		is_listener_.resize(sockfd + 1, 0);
+	is_listener_[sockfd] = 1;
+
+	// also add to poll set (io_uring: start a multishot accept)
+	poller_->watchListener(sockfd);// check ready to read(what u ask)
+}
+
+/*
+	Bind and listen on a unix socket path.
+	A leftover socket file from a crashed run is removed, but only when nothing
+	answers on it: a live server keeps its socket and we fail like a busy TCP port.
+	Static so the master can bind before fork (unix sockets have no SO_REUSEPORT).
+*/
+int Server::bindUnixSocket(const ListenAddress& addr)
+{
+	struct sockaddr_un sun;
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (addr.unix_path.length() >= sizeof(sun.sun_path))
+	{
+		std::cerr << "unix socket path too long: " << addr.unix_path << std::endl;
+		return -1;
+	}
+	memcpy(sun.sun_path, addr.unix_path.c_str(), addr.unix_path.length());
 
-	// also add to poll set
-	struct pollfd pfd;
-	pfd.fd = sockfd;// the socket descriptor
-	pfd.events = POLLIN;// check ready to read(what u ask)
-	pfd.revents = 0;// result of events(what u get)
-	pfds.push_back(pfd);
+	struct stat st;
+	if (lstat(addr.unix_path.c_str(), &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			std::cerr << addr.unix_path << " exists and is not a socket" << std::endl;
+			return -1;
+		}
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (probe < 0)
+			return -1;
+		fcntl(probe, F_SETFL, O_NONBLOCK);
+		// refused: nobody listens any more, the file is stale
+		bool stale = connect(probe, (struct sockaddr *)&sun, sizeof(sun)) == -1 && errno == ECONNREFUSED;
+		close(probe);
+		if (!stale)
+		{
+			std::cerr << addr.unix_path << " is in use" << std::endl;
+			return -1;
+		}
+		unlink(addr.unix_path.c_str());
+	}
 
+	int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sockfd < 0)
+	{
+		perror("socket");
+		return -1;
+	}
+	fcntl(sockfd, F_SETFL, O_NONBLOCK);
+	fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+	if (bind(sockfd, (struct sockaddr *)&sun, sizeof(sun)) < 0)
+	{
+		perror("bind");
+		close(sockfd);
+		return -1;
+	}
+	// chmod before listen(): no client can connect through looser permissions in between
+	if (addr.mode >= 0 && chmod(addr.unix_path.c_str(), static_cast<mode_t>(addr.mode)) == -1)
+		perror("chmod");
+	if (listen(sockfd, addr.backlog) == -1)
+	{
+		perror("listen");
+		close(sockfd);
+		unlink(addr.unix_path.c_str());
+		return -1;
+	}
 	return sockfd;
 }
 
 bool Server::start()
 {
-	std::set<int> ports;// set automatically ensures that each port number appears only once, and keeps sorted in ascending order.
-	// collect unique ports from servers and create a listening socket for each
+	// every distinct address:port gets one socket; std::map keeps them unique and sorted
+	std::map<std::pair<std::string, int>, ListenAddress> binds;
 	for (size_t i = 0; i < servers.size(); ++i)
 	{
-		ports.insert(servers[i].port);
+		for (size_t j = 0; j < servers[i].listens.size(); ++j)
+		{
+			const ListenAddress &listen = servers[i].listens[j];
+			// ConfigParser::checkDuplicatePorts has already rejected repeated addresses
+			binds[std::make_pair(listen.isUnix() ? listen.name() : listen.ip, listen.port)] = listen;
+		}
 	}
 	
-	// if no servers provided, fall back to default socket_fd if previously set
-	if (ports.empty())
+	// if no servers provided, fall back to a default listener on 8080
+	if (binds.empty())
 	{
-		// try to create a default listener on 8080
-		int fd = createListeningSocket(std::string("8080"));
-		return fd >= 0;
+		ListenAddress fallback;
+		fallback.port = 8080;
+		return createListeningSocket(fallback, true) >= 0;
 	}
 
-	// create listening socket for each port
-	for (std::set<int>::const_iterator it = ports.begin(); it != ports.end(); ++it)
+	for (std::map<std::pair<std::string, int>, ListenAddress>::const_iterator it = binds.begin(); it != binds.end(); ++it)
 	{
-		std::ostringstream oss;
-		oss << *it;// convert it to string
-		int fd = createListeningSocket(oss.str());
+		const ListenAddress &addr = it->second;
+		std::string any = addr.isIPv6() ? "::" : "0.0.0.0";
+		// a wildcard socket already receives this address (a second bind would fail),
+		// getsockname() tells the vhosts apart; the parser refused socket options here
+		if (!addr.isUnix() && !addr.isWildcard() && binds.count(std::make_pair(any, addr.port)))
+			continue;
+		bool ipv6only = false;
+		if (addr.ip == "::")
+		{
+			for (std::map<std::pair<std::string, int>, ListenAddress>::const_iterator v4 = binds.begin(); v4 != binds.end(); ++v4)
+				if (v4->second.port == addr.port && !v4->second.isIPv6())
+					ipv6only = true;
+		}
+		int fd = createListeningSocket(addr, ipv6only);
 		
 		if (fd < 0)
 		{
-			std::cerr << "Failed to create listening socket on port " << *it << std::endl;
+			std::cerr << "Failed to create listening socket on " << addr.name() << std::endl;
 			return false;
 		}
 	}
 	return true;
 }
 
-Server::Server() {}
-
-Server::Server(int port, const std::string& root, const std::vector<ServerConfig>& servers)
-: servers(servers), root(root), timeout(15)
+Server::Server(int port, const std::string& root, const std::vector<ServerConfig>& servers, const GlobalConfig& global)
+: poller_(EventPoller::create(global.event_backend)), servers(servers), sink_(NULL), inbox_(NULL), wake_fd_(-1),
+  root(root), global_(global), tick_(0), read_buf_(std::max(global.max_read_size, static_cast<size_t>(READ_BYTES)))
 {
 	(void)port; // legacy single-port ctor keeps signature but real ports come from servers vector
 }
 
 Server::~Server()
 {
-	for (size_t i = 0; i < pfds.size(); ++i)
+	for (size_t i = 0; i < listening_sockets.size(); ++i)
+	{
+		close(listening_sockets[i]);
+	}
+	for (size_t i = 0; i < unix_paths_.size(); ++i)
 	{
-		close(pfds[i].fd);
+		unlink(unix_paths_[i].c_str());
 	}
+	for (size_t i = 0; i < active_fds_.size(); ++i)
+	{
+		close(active_fds_[i]);
+	}
+	delete poller_;
 }
 
 // ============================ Helpers ============================  //
 
 /*
 	Tell poll() that you have something to write
-	"|=" adds bits without removing the current one
+	Clients are always interested in POLLIN, so the interest set is either
+	POLLIN or POLLIN | POLLOUT; want_write avoids re-arming what is already set.
 */
 void Server::enableWrite(int fd)
 {
-	for (size_t i = 0; i < pfds.size(); ++i)
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	// io_uring has no POLLOUT to arm, the bytes go straight to the kernel
+	if (poller_->completionBased())
 	{
-		if (pfds[i].fd == fd) 
-		{
-			pfds[i].events |= POLLOUT; 
-			break;
-		}
+		submitSends(fd);
+		return;
 	}
+	if (conn->want_write)
+		return;
+	if (poller_->modify(fd, POLLIN | POLLOUT))
+		conn->want_write = true;
 }
 
 /*
 	Tell poll() that you have nothing to write
-	"~Flags" means inverse the bits
-	&= keeps everything else, but clears the POLLOUT bit.
-
-	Suppose POLLIN = 0b0001, POLLOUT = 0b0100.
-	Current events = 0b0101 (POLLIN + POLLOUT).
-	~POLLOUT = 0b1011.
-	events & ~POLLOUT = 0b0101 & 0b1011 = 0b0001 → POLLOUT cleared, POLLIN kept.
+	POLLOUT cleared, POLLIN kept.
 */
 void Server::disableWrite(int fd)
 {
-	for (size_t i = 0; i < pfds.size(); ++i)
+	Connection *conn = findConnection(fd);
+	if (!conn || !conn->want_write)
+		return;
+	if (poller_->modify(fd, POLLIN))
+		conn->want_write = false;
+}
+
+void Server::queueResponse(int fd, const std::string& data)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	conn->outbox.append(data);// store response
+	startSending(fd);
+}
+
+void Server::queueResponse(int fd, HTTPResponse& resp)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	std::string raw;
+	resp.releaseRawResponse(raw);
+	conn->outbox.take(raw);
+	startSending(fd);
+}
+
+/*
+	Queue length bytes of an open file from offset; they go out with sendfile
+	instead of through a buffer. file_fd is closed once sent or on disconnect.
+*/
+void Server::queueFile(int fd, int file_fd, off_t offset, size_t length)
+{
+	Connection *conn = findConnection(fd);
+	if (!conn)
 	{
-		if (pfds[i].fd == fd)
-		{
-			pfds[i].events &= ~POLLOUT;
-			break;
-		}
+		close(file_fd);
+		return;
 	}
+	conn->outbox.appendFile(file_fd, offset, length);
+	startSending(fd);
 }
 
-void Server::queueResponse(int fd, const std::string& data)
+/*
+	Something was just queued.
+	Write-through: if nothing is queued ahead of it, send right away instead of
+	waiting a poll round trip for POLLOUT, which only covers what is left.
+*/
+void Server::startSending(int fd)
 {
-	client_state_[fd].outbox.append(data);// store response
-	enableWrite(fd);
+	Connection *conn = findConnection(fd);
+	if (!conn)
+		return;
+	if (poller_->completionBased())
+	{
+		enableWrite(fd);
+		return;
+	}
+	if (!conn->want_write && chargeIo(*conn))
+	{
+		// -1 may just mean the socket buffer is full; errno is not inspected,
+		// POLLOUT retries and a real error shows up there
+		sendQueued(fd, *conn);
+	}
+	if (!conn->outbox.empty())
+		enableWrite(fd);
+}
+
+void Server::setConnectionSink(ConnectionSink *sink)
+{
+	sink_ = sink;
+}
+
+/*
+	wake_fd is an eventfd the acceptor writes to after pushing to inbox;
+	it joins this loop's poll set like any client.
+*/
+void Server::attachInbox(FdQueue *inbox, int wake_fd)
+{
+	inbox_ = inbox;
+	wake_fd_ = wake_fd;
+	poller_->add(wake_fd, POLLIN);
 }
 
 // Ask to close once all queued bytes are sent
 void Server::markCloseAfterWrite(int fd)
 {
-	std::map<int, ClientState>::iterator it = client_state_.find(fd);
-	if (it != client_state_.end())
+	Connection *conn = findConnection(fd);
+	if (conn)
 	{
-		it->second.close_after_write = true;
+		conn->close_after_write = true;
 		// ensure POLLOUT wakes us to flush & close
 		enableWrite(fd);
 	}
 }
+
+PathCache &Server::pathCache()
+{
+	return path_cache_;
+}
 	// Server
 
 	// socket
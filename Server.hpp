@@ -13,49 +13,133 @@
 #include <poll.h>
 #include <iostream>
 #include <set>
+#include <map>
 #include <fcntl.h>
+#include <csignal>
 #include "http/HTTP.hpp"
 #include "http/HTTPRequest/HTTPRequest.hpp"
+#include "event/EventPoller.hpp"
+#include "event/TimerHeap.hpp"
+#include "event/FdQueue.hpp"
+#include "event/OutputChain.hpp"
+#include "http/PathCache.hpp"
+
+// bytes a lingering connection reads and drops before it is closed anyway: room for
+// the rest of a refused upload, while lingering_time bounds how long that may take
+# define LINGER_DISCARD_MAX (64 * 1024 * 1024)
+
+extern volatile sig_atomic_t g_running; // cleared by SIGINT/SIGTERM
+void setupSignalHandler();
+
+/*
+	Takes over freshly accepted client fds instead of the Server that accepted them
+	(the acceptor in reactor_threads mode). Returning false means the fd was refused.
+*/
+class ConnectionSink
+{
+	public:
+		virtual ~ConnectionSink() {}
+		virtual bool dispatch(int client_fd) = 0;
+};
 
 class Server
 {
 	private:
 		std::vector<int> listening_sockets;
-		std::vector<struct pollfd> pfds;
-		std::vector<ServerConfig> servers; // configurations parsed from config file
+		std::vector<char> is_listener_; // indexed by fd, 1 for our listening sockets
+		std::vector<std::string> unix_paths_; // unix sockets we bound, unlinked on shutdown
+		EventPoller *poller_; // epoll, poll or io_uring, picked from event_backend
+		const std::vector<ServerConfig>& servers; // configurations parsed from config file, shared read-only
+		ConnectionSink *sink_; // if set, accepted fds are handed off instead of served here
+		FdQueue *inbox_; // reactor mode: fds handed to us by the acceptor
+		int wake_fd_; // reactor mode: signalled after every push to inbox_
 		// stored root for single-server compatibility (optional)
 		std::string root;
-		std::map<int, time_t> last_activity; //track last activity per fd
-		int timeout;
+		GlobalConfig global_; // timeouts and other process-wide settings
+
+		// Which deadline a client is currently running against
+		enum TimerPhase { PHASE_HEADER, PHASE_BODY, PHASE_IDLE, PHASE_SEND, PHASE_LINGER };
+		TimerHeap timers_; // one deadline per client fd
 
-		// Per-client write buffer + close-after-write flag
-		struct ClientState { std::string outbox; bool close_after_write; };
-		std::map<int, ClientState> client_state_; // by client fd
+		// Everything we keep for one client socket
+		struct Connection
+		{
+			HTTPRequest request; // parser state for the request being received
+			RouteContext route; // where that request goes, once its headers are in
+			OutputChain outbox; // responses queued for send(), partial sends just move its cursor
+			bool send_inflight; // completion backend: a submitSend has not reported back
+			bool close_after_write;
+			bool lingering; // response sent, sending side shut down, input read and dropped
+			size_t linger_left; // bytes still allowed to be dropped
+			long long linger_until; // lingering_time deadline
+			bool want_write; // POLLOUT currently armed
+			bool nopush; // tcp_nopush: cork while a file body is queued
+			bool corked;
+			size_t read_size; // next recv() size, adapts between READ_BYTES and max_read_size
+			int io_used; // reads + writes charged in loop iteration io_tick
+			unsigned long io_tick;
+			bool in_use;
+			TimerPhase phase;
+			size_t slot; // position in active_fds_
+
+			Connection();
+		};
+		std::vector<Connection> connections_; // indexed by client fd
+		std::vector<int> active_fds_; // open client fds, dense (swap-and-pop on close)
+		unsigned long tick_; // event loop iterations, for the per-connection io_budget
+		std::vector<char> read_buf_; // recv() scratch space of max_read_size, shared by this loop's clients
+		PathCache path_cache_; // resolved static file paths, private to this loop
 		
+		Server(const Server &other);
+		Server &operator=(const Server &other);
+
 		// helper
-		void addNewConnection(int listen_fd, std::map<int, HTTPRequest> &request_map);
-		void addPfds(int client_fd);
-		void removePfds(int i);
-		bool isListeningSocket(int fd);
-		void checkTimeOut(std::map<int, HTTPRequest> request_map);
+		Connection *findConnection(int fd);
+		void addNewConnection(int listen_fd);
+		void acceptClient(int client_fd);
+		void registerClient(int client_fd);
+		void registerListener(int sockfd);
+		void setLocalAddress(int client_fd, HTTPRequest &request);
+		void tuneClient(int client_fd, Connection &conn);
+		ssize_t sendQueued(int fd, Connection &conn);
+		void setCork(int fd, Connection &conn, bool on);
+		void drainInbox();
+		void handleEvent(const PollEvent &ev);
+		void handleCompletion(const PollEvent &ev);
+		bool chargeIo(Connection &conn);
+		bool flushClient(int fd);
+		void submitSends(int fd);
+		void closeConnection(int fd);
+		void closeAfterWrite(int fd);
+		void discardLingering(int fd, ssize_t len);
+		bool isListeningSocket(int fd) const;
+		void checkTimeOut();
+		void refreshTimer(int fd, bool activity);
+		int nextTimeout() const;
 		void enableWrite(int fd);
 		void disableWrite(int fd);
+		void startSending(int fd);
 
 	public:
-		// default constructor
-		Server();
 		// constructor
-		Server(int port, const std::string& root, const std::vector<ServerConfig>& servers);
+		Server(int port, const std::string& root, const std::vector<ServerConfig>& servers, const GlobalConfig& global);
 		// start listening on ports derived from the provided ServerConfig(s)
 		// destructor
 		~Server();
 	
-		int createListeningSocket(const std::string& port_str);
+		int createListeningSocket(const ListenAddress& addr, bool ipv6only);
+		static int bindUnixSocket(const ListenAddress& addr);
 		void run();
 		bool start();
 		void queueResponse(int fd, const std::string& data);
+		void queueResponse(int fd, HTTPResponse& resp); // takes the response's bytes, no copy
+		void queueFile(int fd, int file_fd, off_t offset, size_t length); // sent with sendfile, file_fd is ours
 		void markCloseAfterWrite(int fd);
-		friend void readClientData(int socketFD, std::map<int, HTTPRequest>& requestMap, std::vector<struct pollfd>& fds, size_t &i, const std::vector<ServerConfig>& servers, Server& srv);
+		PathCache &pathCache();
+		void setConnectionSink(ConnectionSink *sink);
+		void attachInbox(FdQueue *inbox, int wake_fd);
+		friend void readClientData(int socketFD, const std::vector<ServerConfig>& servers, Server& srv);
+		friend void receiveClientData(int socketFD, const char *data, ssize_t len, const std::vector<ServerConfig>& servers, Server& srv);
 
 };
 
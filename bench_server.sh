@@ -0,0 +1,418 @@
+#!/usr/bin/env bash
+set -Eeuo pipefail
+
+# Benchmark scenarios for webserv. Usage: ./bench_server.sh [scenario...]
+# Results are printed and appended to bench_output.txt.
+
+# -----------------------------
+# Helper functions (define first)
+# -----------------------------
+say()   { printf "%s\n" "$*" | tee -a "$OUT_FILE"; }
+fatal() { printf "[FATAL] %s\n" "$*"; exit 1; }
+
+have_cmd() { command -v "$1" >/dev/null 2>&1; }
+
+wait_port_up() {
+  local port="$1" deadline=$((SECONDS+STARTUP_WAIT_SECS))
+  while (( SECONDS < deadline )); do
+    if curl -sS -m 0.3 "http://${HOST}:${port}/" >/dev/null 2>&1; then
+      return 0
+    fi
+    sleep 0.15
+  done
+  return 1
+}
+
+start_server() {
+  "$BIN_PATH" "$CFG_FILE" >>"$LOG_FILE" 2>&1 &
+  SERVER_PID=$!
+  wait_port_up "$PORT" || fatal "Server did not start on port ${PORT}"
+}
+
+# SIGTERM lets the server exit normally (the alloc scenario reads its exit report)
+stop_server() {
+  [[ -n "${SERVER_PID:-}" ]] || return 0
+  kill "${SERVER_PID}" 2>/dev/null || true
+  wait "${SERVER_PID}" 2>/dev/null || true
+  SERVER_PID=""
+}
+
+# Reads one number per line, prints "n= p50= p99= max=" (milliseconds)
+percentiles() {
+  sort -n | awk '
+    { v[NR] = $1 * 1000 }
+    END {
+      if (NR == 0) { print "n=0"; exit }
+      p50 = v[int((NR - 1) * 0.50) + 1]; p99 = v[int((NR - 1) * 0.99) + 1]
+      printf "n=%d p50=%.2fms p99=%.2fms max=%.2fms\n", NR, p50, p99, v[NR]
+    }'
+}
+
+# -----------------------------
+# Config (override via env vars)
+# -----------------------------
+CFG_FILE="${CFG_FILE:-testconfig/test.conf}"
+LOG_FILE="${LOG_FILE:-server_bench.log}"
+OUT_FILE="${OUT_FILE:-bench_output.txt}"
+BIN_PATH="${BIN:-./webserv}"
+HOST="127.0.0.1"
+PORT="${PORT:-8080}"
+STARTUP_WAIT_SECS=6
+BURST="${BURST:-500}"       # concurrent connections opened at once
+ROUNDS="${ROUNDS:-5}"       # bursts per run
+REQUESTS="${REQUESTS:-200}" # requests per path in sequential scenarios
+TTFB_PATHS="${TTFB_PATHS:-/ /index.html}"
+ALLOC_PATH="${ALLOC_PATH:-/index.html}"
+ALLOC_HEADERS="${ALLOC_HEADERS:-8}" # extra request headers in the alloc scenario
+UPLOAD_MB="${UPLOAD_MB:-8}"         # size of the file the upload scenario posts
+UPLOAD_ROUNDS="${UPLOAD_ROUNDS:-5}"
+PIPELINE_DEPTH="${PIPELINE_DEPTH:-2000}" # requests written back to back in the pipeline scenario
+PIPELINE_PATH="${PIPELINE_PATH:-/index.html}"
+ROUTES="${ROUTES:-500}" # locations in the routes scenario
+TMP_DIR="$(mktemp -d -t webserv-bench-XXXXXX)"
+
+cleanup() {
+  set +e
+  [[ -n "${SERVER_PID:-}" ]] && kill "${SERVER_PID}" 2>/dev/null && wait "${SERVER_PID}" 2>/dev/null
+  rm -rf "$TMP_DIR" >/dev/null 2>&1 || true
+}
+trap 'cleanup' EXIT INT TERM
+
+have_cmd curl || fatal "curl is required"
+[[ -x "$BIN_PATH" ]] || fatal "Server binary not found: ${BIN_PATH} (run make)"
+[[ -f "$CFG_FILE" ]] || fatal "Config file not found: ${CFG_FILE}"
+
+# -----------------------------
+# Scenarios
+# -----------------------------
+
+# Connect latency under a burst: BURST clients connect at the same moment, ROUNDS times.
+# time_connect is how long the handshake took (listen backlog), time_total how long until
+# the response arrived (how fast the server takes connections off the accept queue).
+bench_accept() {
+  say "== accept: ${ROUNDS} x ${BURST} concurrent connections to :${PORT} =="
+  local r
+  : > "$TMP_DIR/accept"
+  for (( r = 0; r < ROUNDS; ++r )); do
+    seq "$BURST" | xargs -P "$BURST" -I{} \
+      curl -s -o /dev/null -m 10 -w '%{time_connect} %{time_total}\n' \
+      "http://${HOST}:${PORT}/" >> "$TMP_DIR/accept" 2>/dev/null || true
+  done
+  say "connect: $(awk '{ print $1 }' "$TMP_DIR/accept" | percentiles)"
+  say "total:   $(awk '{ print $2 }' "$TMP_DIR/accept" | percentiles)"
+  say "failed:  $(( ROUNDS * BURST - $(wc -l < "$TMP_DIR/accept") ))"
+}
+
+# Time to first byte, REQUESTS sequential requests per path, once on fresh connections and
+# once over one keep-alive connection. Compare runs with tcp_nodelay / tcp_nopush and the
+# listen socket options toggled in CFG_FILE.
+bench_ttfb() {
+  say "== ttfb: ${REQUESTS} requests per path to :${PORT} =="
+  local path urls i
+  for path in $TTFB_PATHS; do
+    : > "$TMP_DIR/ttfb_new"
+    for (( i = 0; i < REQUESTS; ++i )); do
+      curl -s -o /dev/null -m 10 -w '%{time_starttransfer}\n' \
+        "http://${HOST}:${PORT}${path}" >> "$TMP_DIR/ttfb_new" 2>/dev/null || true
+    done
+    urls=()
+    for (( i = 0; i < REQUESTS; ++i )); do
+      urls+=( -o /dev/null "http://${HOST}:${PORT}${path}" )
+    done
+    # curl reuses one connection for all urls; starttransfer is per transfer
+    curl -s -m 60 -w '%{time_starttransfer}\n' "${urls[@]}" \
+      > "$TMP_DIR/ttfb_keepalive" 2>/dev/null || true
+    say "${path} new conn:   $(percentiles < "$TMP_DIR/ttfb_new")"
+    say "${path} keep-alive: $(percentiles < "$TMP_DIR/ttfb_keepalive")"
+  done
+}
+
+# Heap allocations per request. The server runs with a preloaded malloc counter that
+# reports at exit; it is restarted for REQUESTS and 2 x REQUESTS keep-alive requests
+# (ALLOC_PATH, ALLOC_HEADERS extra headers each) and the difference is divided by
+# REQUESTS, so startup and shutdown cancel out.
+bench_alloc() {
+  have_cmd cc || fatal "cc is required for the alloc scenario"
+  local lib="$TMP_DIR/alloccount.so" n c1 c2 i
+  cat > "$TMP_DIR/alloccount.c" <<'EOF'
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+static unsigned long count;
+void *malloc(size_t n) { __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED); return __libc_malloc(n); }
+void *calloc(size_t a, size_t b) { __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED); return __libc_calloc(a, b); }
+void *realloc(void *p, size_t n) { __atomic_add_fetch(&count, 1, __ATOMIC_RELAXED); return __libc_realloc(p, n); }
+__attribute__((destructor)) static void report(void)
+{
+  const char *path = getenv("ALLOC_OUT");
+  FILE *f = path ? fopen(path, "w") : NULL;
+  if (f) { fprintf(f, "%lu\n", count); fclose(f); }
+}
+EOF
+  cc -O2 -shared -fPIC -o "$lib" "$TMP_DIR/alloccount.c" || fatal "could not build the malloc counter"
+  local hdrs=()
+  for (( i = 0; i < ALLOC_HEADERS; ++i )); do
+    hdrs+=( -H "X-Bench-Header-${i}: value-${i}-abcdefghijklmnopqrstuvwxyz" )
+  done
+  say "== alloc: heap allocations per request, ${ALLOC_PATH} with ${ALLOC_HEADERS} extra headers =="
+  stop_server
+  for n in "$REQUESTS" $(( REQUESTS * 2 )); do
+    local urls=()
+    for (( i = 0; i < n; ++i )); do
+      urls+=( -o /dev/null "http://${HOST}:${PORT}${ALLOC_PATH}" )
+    done
+    ALLOC_OUT="$TMP_DIR/alloc_${n}" LD_PRELOAD="$lib" "$BIN_PATH" "$CFG_FILE" >>"$LOG_FILE" 2>&1 &
+    SERVER_PID=$!
+    wait_port_up "$PORT" || fatal "Server did not start on port ${PORT}"
+    curl -s -m 120 "${hdrs[@]}" "${urls[@]}" 2>/dev/null || true
+    stop_server
+  done
+  c1=$(cat "$TMP_DIR/alloc_${REQUESTS}")
+  c2=$(cat "$TMP_DIR/alloc_$(( REQUESTS * 2 ))")
+  say "allocations/request: $(awk -v a="$c1" -v b="$c2" -v n="$REQUESTS" 'BEGIN { printf "%.1f", (b - a) / n }')"
+  start_server
+}
+
+# Server memory for large uploads: UPLOAD_ROUNDS posts of a UPLOAD_MB file to /upload/,
+# as a plain body, chunked and multipart, each mode on a freshly started server so its
+# peak RSS (VmHWM) is its own. Reported as the peak above the idle server.
+bench_upload() {
+  [[ -r "/proc/self/status" ]] || fatal "the upload scenario reads /proc/<pid>/status"
+  local file="$TMP_DIR/upload.bin" url="http://${HOST}:${PORT}/upload/bench_upload.bin"
+  local mode idle peak i
+  head -c "$(( UPLOAD_MB * 1024 * 1024 ))" /dev/urandom > "$file"
+  say "== upload: ${UPLOAD_ROUNDS} x ${UPLOAD_MB} MB to :${PORT}/upload/ =="
+  for mode in raw chunked multipart; do
+    stop_server
+    start_server
+    idle=$(awk '/^VmHWM/ { print $2 }' "/proc/${SERVER_PID}/status")
+    : > "$TMP_DIR/upload_times"
+    for (( i = 0; i < UPLOAD_ROUNDS; ++i )); do
+      case "$mode" in
+        raw)       curl -s -o /dev/null -m 60 -w '%{time_total}\n' --data-binary "@${file}" \
+                     -H "Content-Type: application/octet-stream" "$url" ;;
+        chunked)   curl -s -o /dev/null -m 60 -w '%{time_total}\n' --data-binary "@${file}" \
+                     -H "Content-Type: application/octet-stream" -H "Transfer-Encoding: chunked" "$url" ;;
+        multipart) curl -s -o /dev/null -m 60 -w '%{time_total}\n' \
+                     -F "file=@${file};filename=bench_upload.bin" "http://${HOST}:${PORT}/upload/" ;;
+      esac >> "$TMP_DIR/upload_times" 2>/dev/null || true
+      curl -s -o /dev/null -m 10 -X DELETE "$url" 2>/dev/null || true
+    done
+    peak=$(awk '/^VmHWM/ { print $2 }' "/proc/${SERVER_PID}/status")
+    say "${mode}: peak RSS +$(( (peak - idle) / 1024 )) MB, time $(percentiles < "$TMP_DIR/upload_times")"
+  done
+}
+
+# Deep HTTP/1.1 pipelining: PIPELINE_DEPTH GETs for PIPELINE_PATH written in one go on one
+# connection (the last asks to close), ROUNDS times; time until the server closed after the
+# last response. Parsing in place makes this linear in the depth instead of quadratic.
+bench_pipeline() {
+  have_cmd python3 || fatal "python3 is required for the pipeline scenario"
+  say "== pipeline: ${ROUNDS} x ${PIPELINE_DEPTH} pipelined requests for ${PIPELINE_PATH} =="
+  python3 - "$HOST" "$PORT" "$PIPELINE_PATH" "$PIPELINE_DEPTH" "$ROUNDS" > "$TMP_DIR/pipeline" <<'EOF'
+import socket, sys, threading, time
+host, port, path, depth, rounds = sys.argv[1], int(sys.argv[2]), sys.argv[3], int(sys.argv[4]), int(sys.argv[5])
+req = ("GET %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: bench\r\nAccept: */*\r\n\r\n" % (path, host, port)).encode()
+last = req[:-2] + b"Connection: close\r\n\r\n"
+batch = req * (depth - 1) + last
+for _ in range(rounds):
+    s = socket.create_connection((host, port))
+    start = time.time()
+    sender = threading.Thread(target=s.sendall, args=(batch,))
+    sender.start()
+    got = 0
+    while True:
+        data = s.recv(1 << 20)
+        if not data:
+            break
+        got += len(data)
+    sender.join()
+    s.close()
+    print("%f %d" % (time.time() - start, got))
+EOF
+  say "time: $(awk '{ print $1 }' "$TMP_DIR/pipeline" | percentiles)"
+  say "bytes received per round: $(awk 'NR == 1 { print $2 }' "$TMP_DIR/pipeline")"
+}
+
+# Microbenchmark of the delimiter scans in http/ByteScan.cpp against std::string::find,
+# once per kernel set the CPU supports. Built with SCAN_CXXFLAGS, -O2 by default like
+# the Makefile builds ByteScan.o.
+bench_scan() {
+  have_cmd c++ || fatal "c++ is required for the scan scenario"
+  cat > "$TMP_DIR/scanbench.cpp" <<'EOF'
+#include "http/ByteScan.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+static double now() { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec / 1e9; }
+static volatile size_t sink;
+
+// every line of a header block, then its colon (what the request parser does)
+static size_t lines(const std::string &h, bool simd)
+{
+  size_t n = 0, at = 0, nl;
+  while ((nl = simd ? scanFind(h, '\n', at) : h.find('\n', at)) != std::string::npos)
+  {
+    std::string::size_type colon = simd ? scanFind(h, ':', at) : h.find(':', at);
+    n += colon + nl;
+    at = nl + 1;
+  }
+  return n;
+}
+
+template <typename F>
+static void run(const char *what, const char *impl, size_t bytes, int reps, F f)
+{
+  double t = now();
+  for (int i = 0; i < reps; ++i)
+    sink = f();
+  t = now() - t;
+  printf("%-22s %-11s %9.1f MB/s\n", what, impl, bytes * (double)reps / t / 1e6);
+}
+
+struct Lines { const std::string &h; bool simd; size_t operator()() const { return lines(h, simd); } };
+struct Needle { const std::string &h; const std::string &n; bool simd;
+  size_t operator()() const { return simd ? scanFind(h, n) : h.find(n); } };
+
+int main()
+{
+  std::string header = "GET /index.html HTTP/1.1\r\nHost: localhost:8080\r\n";
+  for (int i = 0; i < 12; ++i)
+  {
+    char line[96];
+    snprintf(line, sizeof(line), "X-Header-%d: value-%d-abcdefghijklmnopqrstuvwxyz0123456789\r\n", i, i);
+    header += line;
+  }
+  std::string headerEnd(8192, 'a');
+  for (size_t i = 64; i < headerEnd.size(); i += 64)
+    headerEnd.replace(i - 2, 2, "\r\n");
+  headerEnd += "\r\n\r\n";
+  const std::string boundary = "\r\n--------------------------974767299852498929531610--";
+  std::string body(8 << 20, '\0');
+  srand(42);
+  for (size_t i = 0; i < body.size(); ++i)
+    body[i] = (char)(rand() & 0xff);
+  body += boundary;
+  const std::string crlf2 = "\r\n\r\n";
+
+  const char *backends[] = { "avx2", "sse2", "scalar" };
+  Lines l0 = { header, false };
+  Needle e0 = { headerEnd, crlf2, false }, b0 = { body, boundary, false };
+  run("header lines + colon", "string::find", header.size(), 200000, l0);
+  run("CRLFCRLF in 8k", "string::find", headerEnd.size(), 20000, e0);
+  run("boundary in 8M body", "string::find", body.size(), 20, b0);
+  for (size_t i = 0; i < 3; ++i)
+  {
+    if (!scanUseBackend(backends[i]))
+      continue;
+    Lines l = { header, true };
+    Needle e = { headerEnd, crlf2, true }, b = { body, boundary, true };
+    run("header lines + colon", backends[i], header.size(), 200000, l);
+    run("CRLFCRLF in 8k", backends[i], headerEnd.size(), 20000, e);
+    run("boundary in 8M body", backends[i], body.size(), 20, b);
+  }
+  return 0;
+}
+EOF
+  c++ -std=c++98 ${SCAN_CXXFLAGS:--O2} -I. -o "$TMP_DIR/scanbench" "$TMP_DIR/scanbench.cpp" http/ByteScan.cpp \
+    || fatal "could not build the scan benchmark"
+  say "== scan: delimiter search throughput (${SCAN_CXXFLAGS:--O2}) =="
+  "$TMP_DIR/scanbench" | while IFS= read -r line; do say "$line"; done
+}
+
+# Location lookup: the radix trie of http/RouteTable.cpp against the linear prefix scan it
+# replaced, for ROUTES locations like "/api/v1/service17/" and paths below them.
+bench_routes() {
+  have_cmd c++ || fatal "c++ is required for the routes scenario"
+  cat > "$TMP_DIR/routebench.cpp" <<'EOF'
+#include "http/RouteTable.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+static double now() { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec / 1e9; }
+static volatile int sink;
+
+static int linear(const std::vector<std::string> &locations, const std::string &path)
+{
+  int best = -1;
+  size_t best_len = 0;
+  for (size_t i = 0; i < locations.size(); ++i)
+    if (path.find(locations[i]) == 0 && locations[i].length() > best_len)
+    {
+      best = (int)i;
+      best_len = locations[i].length();
+    }
+  return best;
+}
+
+int main(int argc, char **argv)
+{
+  int count = argc > 1 ? atoi(argv[1]) : 500;
+  std::vector<std::string> locations;
+  RouteTable table;
+  locations.push_back("/");
+  for (int i = 0; i < count - 1; ++i)
+  {
+    char path[64];
+    snprintf(path, sizeof(path), "/api/v%d/service%d/", i % 3 + 1, i);
+    locations.push_back(path);
+  }
+  for (size_t i = 0; i < locations.size(); ++i)
+    table.add(locations[i], (int)i);
+  std::vector<std::string> paths;
+  srand(42);
+  for (int i = 0; i < 1000; ++i)
+  {
+    char path[96];
+    int n = rand() % (count + count / 10); // some miss every location but "/"
+    snprintf(path, sizeof(path), "/api/v%d/service%d/items/%d", n % 3 + 1, n, i);
+    paths.push_back(path);
+  }
+  for (size_t i = 0; i < paths.size(); ++i)
+    if (table.match(paths[i]) != linear(locations, paths[i]))
+      return printf("mismatch on %s\n", paths[i].c_str()), 1;
+  const int reps = 200;
+  double t = now();
+  for (int r = 0; r < reps; ++r)
+    for (size_t i = 0; i < paths.size(); ++i)
+      sink = linear(locations, paths[i]);
+  double linear_ns = (now() - t) * 1e9 / (reps * paths.size());
+  t = now();
+  for (int r = 0; r < reps; ++r)
+    for (size_t i = 0; i < paths.size(); ++i)
+      sink = table.match(paths[i]);
+  double trie_ns = (now() - t) * 1e9 / (reps * paths.size());
+  printf("%d locations: linear scan %.0f ns, trie %.0f ns per lookup\n", count, linear_ns, trie_ns);
+  return 0;
+}
+EOF
+  c++ -std=c++98 -O2 -I. -o "$TMP_DIR/routebench" "$TMP_DIR/routebench.cpp" http/RouteTable.cpp \
+    || fatal "could not build the routes benchmark"
+  say "== routes: location lookup, ${ROUTES} locations =="
+  "$TMP_DIR/routebench" "$ROUTES" | while IFS= read -r line; do say "$line"; done
+}
+
+# -----------------------------
+# Run
+# -----------------------------
+SCENARIOS=( "$@" )
+(( ${#SCENARIOS[@]} )) || SCENARIOS=( accept )
+for s in "${SCENARIOS[@]}"; do
+  declare -F "bench_${s}" >/dev/null || fatal "Unknown scenario: ${s}"
+done
+
+: > "$LOG_FILE"
+start_server
+say "# $(date '+%Y-%m-%d %H:%M:%S') config=${CFG_FILE}"
+
+for s in "${SCENARIOS[@]}"; do
+  "bench_${s}"
+done
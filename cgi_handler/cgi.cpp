@@ -28,7 +28,7 @@ void CGIHandler::clearEnvironment() {
 
 CGIResult CGIHandler::executeCGI(const HTTPRequest& request, 
                                 const std::string& script_path,
-                                const std::map<std::string, std::string>& cgi_extensions,
+                                const std::string& executor,
                                 const std::string& working_directory,
                                 const std::string& server_name,
                                 int server_port) {
@@ -40,26 +40,11 @@ CGIResult CGIHandler::executeCGI(const HTTPRequest& request,
     std::cout << "[DEBUG] CGI executeCGI - Original script_path: " << script_path << std::endl;
     std::cout << "[DEBUG] CGI executeCGI - Working directory: " << working_directory << std::endl;
      
-    /*
-    clean up the path to remove things like:
-            Double slashes (//)
-            . and .. references
-            Any accidental duplicates (cgi_bin/cgi_bin/...)
-    */
-    std::string normalized_script_path = CGIHelper::normalizePath(script_path);
+    // The request parser already decoded the path and resolved "." / ".." segments;
+    // normalizing again here would decode it twice ("%252e" -> "%2e" -> ".").
+    std::string normalized_script_path = script_path;
     std::cout << "[DEBUG] CGI executeCGI - Normalized script_path: " << normalized_script_path << std::endl;
     
-    // check whether is CGI script (.py) , if not then 404
-    if (!CGIHelper::isCGIScript(normalized_script_path, cgi_extensions)) {
-        result.success = false;
-        result.status_code = 404;
-        result.status_message = CGIHelper::getStatusMessage(404);
-        result.headers = "Content-Type: text/html";
-        result.body = "<html><body><h1>404 Not Found</h1><p>The requested CGI script was not found.</p></body></html>";
-        result.content = result.headers + "\r\n\r\n" + result.body;
-        return result;
-    }
-    
     // Check if the script file actually exists and is executable
     std::string full_script_path = working_directory + "/" + normalized_script_path;
     if (access(full_script_path.c_str(), F_OK) != 0) {
@@ -82,10 +67,7 @@ CGIResult CGIHandler::executeCGI(const HTTPRequest& request,
         return result;
     }
     
-    // Find the appropriate executor
-    std::string extension = CGIHelper::getFileExtension(normalized_script_path);
-    std::string executor = CGIHelper::findCGIExecutor(extension, cgi_extensions);
-    std::cout << "[DEBUG] CGI executeCGI - Extension: " << extension << std::endl;
+    // The executor was looked up from the location's cgi_extension map when the route was resolved
     std::cout << "[DEBUG] CGI executeCGI - Executor: " << executor << std::endl;
     
     if (executor.empty()) {
@@ -184,7 +166,14 @@ CGIResult CGIHandler::executeCGI(const HTTPRequest& request,
 
         
         // Redirect stdin and stdout
-        dup2(input_pipe[0], STDIN_FILENO);
+        // a body spilled to a temp file is the script's stdin as it is, nothing is copied
+        int body_fd = request.getBodyFile();
+        if (request.getMethodId() == METHOD_POST && body_fd >= 0) {
+            lseek(body_fd, 0, SEEK_SET);
+            dup2(body_fd, STDIN_FILENO);
+        } else {
+            dup2(input_pipe[0], STDIN_FILENO);
+        }
         dup2(output_pipe[1], STDOUT_FILENO);
         
         // Close unused pipe ends
@@ -192,6 +181,9 @@ CGIResult CGIHandler::executeCGI(const HTTPRequest& request,
         close(output_pipe[0]);
         close(input_pipe[0]);
         close(output_pipe[1]);
+
+        // the server ignores SIGPIPE, and an ignored signal survives execve
+        signal(SIGPIPE, SIG_DFL);
         
         // Prepare arguments - script path as first argument as per webserv requirements
         char* args[3];
@@ -210,11 +202,10 @@ CGIResult CGIHandler::executeCGI(const HTTPRequest& request,
         close(input_pipe[0]);
         close(output_pipe[1]);
         
-        // Send request body to CGI script (for POST requests)
-        if (request.getMethod() == "POST") {
-            const std::vector<char>& body = request.getBodyVector();
-            if (!body.empty()) {
-                ssize_t bytes_written = write(input_pipe[1], &body[0], body.size());
+        // Send request body to CGI script (for POST requests) unless it reads the temp file
+        if (request.getMethodId() == METHOD_POST && request.getBodyFile() < 0) {
+            if (request.getBodySize() > 0) {
+                ssize_t bytes_written = write(input_pipe[1], request.getBodyData(), request.getBodySize());
                 (void)bytes_written; // Avoid unused variable warning
             }
         }
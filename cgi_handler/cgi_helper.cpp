@@ -44,9 +44,8 @@ void setupStandardCGIVars(std::map<std::string, std::string>& env_vars, const HT
         std::cout << "[DEBUG] Header: '" << it->first << "' = '" << it->second << "'" << std::endl;
     }
     
-    if (request.getMethod() == "POST") {
-        const std::vector<char>& body = request.getBodyVector();
-        addEnvironmentVar(env_vars, "CONTENT_LENGTH", intToString(body.size()));
+    if (request.getMethodId() == METHOD_POST) {
+        addEnvironmentVar(env_vars, "CONTENT_LENGTH", intToString(request.getBodySize()));
         
         // Get content type from headers
         if (ct_it != headers.end()) {
@@ -75,6 +74,10 @@ void setupHTTPHeaders(std::map<std::string, std::string>& env_vars, const HTTPRe
     // Convert HTTP headers to CGI environment variables
     for (std::map<std::string, std::string>::const_iterator it = headers.begin();
          it != headers.end(); ++it) {
+        // an inflated body reaches the script plain, its coding is not passed on
+        if (request.isBodyDecoded() && it->first == "content-encoding") {
+            continue;
+        }
         std::string key = "HTTP_" + toUpperCase(it->first);
         addEnvironmentVar(env_vars, key, it->second);
     }
@@ -102,32 +105,14 @@ bool isCGIScript(const std::string& filepath, const std::map<std::string, std::s
 check if the file extension is in the cgi_extensions map
 
 -> something like this  ( cgi_extensions[".py"] = "/usr/bin/python3";)
-if extension not found, return empty string
+returns the executor inside the map, NULL if the extension is not found
 */
-std::string findCGIExecutor(const std::string& extension, const std::map<std::string, std::string>& cgi_extensions) {
-    std::map<std::string, std::string>::const_iterator it = cgi_extensions.find(extension);
+const std::string* findCGIExecutor(const std::string& filepath, const std::map<std::string, std::string>& cgi_extensions) {
+    std::map<std::string, std::string>::const_iterator it = cgi_extensions.find(getFileExtension(filepath));
     if (it != cgi_extensions.end()) {
-        return it->second;
-    }
-    return "";
-}
-
-std::string normalizePath(const std::string& path) {
-    std::string result = path;
-    
-    // Remove duplicate slashes
-    size_t pos = 0;
-    while ((pos = result.find("//", pos)) != std::string::npos) {
-        result.erase(pos, 1);
-    }
-    
-    // Remove duplicate "./cgi_bin" if it appears twice
-    pos = result.find("./cgi_bin/./cgi_bin");
-    if (pos != std::string::npos) {
-        result.erase(pos, 11); // Remove first "./cgi_bin/"
+        return &it->second;
     }
-    
-    return result;
+    return NULL;
 }
 
 // Output processing helpers
@@ -31,8 +31,7 @@ namespace CGIHelper {
 
     std::string getFileExtension(const std::string& filepath);
     bool isCGIScript(const std::string& filepath, const std::map<std::string, std::string>& cgi_extensions);
-    std::string findCGIExecutor(const std::string& extension, const std::map<std::string, std::string>& cgi_extensions);
-    std::string normalizePath(const std::string& path);
+    const std::string* findCGIExecutor(const std::string& filepath, const std::map<std::string, std::string>& cgi_extensions);
     
    
     void parseOutput(const std::string& output, CGIResult& result);
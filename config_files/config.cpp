@@ -1,8 +1,55 @@
 #include "config.hpp"
+#include <unistd.h>
+#include <arpa/inet.h>
 
 // ==================== CONSTRUCTORS ====================
 
-ServerConfig::ServerConfig() : port(0), client_max_body_size(0) {
+ServerConfig::ServerConfig()
+    : port(0), client_max_body_size(0), tcp_nodelay(true), tcp_nopush(false) {
+}
+
+ListenAddress::ListenAddress()
+    : ip("0.0.0.0"), port(0), mode(-1), fd(-1), backlog(511), deferred(false), fastopen(0),
+      rcvbuf(0), sndbuf(0) {
+}
+
+bool ListenAddress::isWildcard() const {
+    return ip == "0.0.0.0" || ip == "::";
+}
+
+bool ListenAddress::isIPv6() const {
+    return ip.find(':') != std::string::npos;
+}
+
+bool ListenAddress::isUnix() const {
+    return !unix_path.empty();
+}
+
+bool ListenAddress::hasSocketOptions() const {
+    return backlog != 511 || deferred || fastopen != 0 || rcvbuf != 0 || sndbuf != 0;
+}
+
+std::string ListenAddress::name() const {
+    if (isUnix()) {
+        return "unix:" + unix_path;
+    }
+    std::ostringstream oss;
+    if (isIPv6()) {
+        oss << "[" << ip << "]:" << port;
+    } else {
+        oss << ip << ":" << port;
+    }
+    return oss.str();
+}
+
+GlobalConfig::GlobalConfig()
+    : event_backend("auto"), client_header_timeout(15), client_body_timeout(15),
+      keepalive_timeout(15), send_timeout(15), lingering_time(30), lingering_timeout(5),
+      worker_processes(1),
+      worker_cpu_affinity(false), reactor_threads(0), io_budget(4),
+      accept_batch(16), read_budget(256 * 1024), max_read_size(64 * 1024),
+      header_buffers(4), header_buffer_size(8 * 1024), max_request_headers(100),
+      client_body_buffer_size(16 * 1024), client_body_temp_path("/tmp") {
 }
 
 // ==================== MAIN CONFIGURATION FUNCTIONS ====================
@@ -15,6 +62,7 @@ std::vector<ServerConfig> ConfigParser::    parseConfig(const std::string& filen
     }
     
     std::vector<ServerConfig> servers;
+    global_config = GlobalConfig();
     std::string line;
     ServerConfig current_server;
     Location current_location;
@@ -45,6 +93,10 @@ std::vector<ServerConfig> ConfigParser::    parseConfig(const std::string& filen
         }
         else if (line == "}" && in_server) {
             if (validateServerConfig(current_server)) {
+                // compiled once here, every request's location is looked up in it
+                for (size_t i = 0; i < current_server.locations.size(); ++i) {
+                    current_server.routes.add(current_server.locations[i].path, static_cast<int>(i));
+                }
                 servers.push_back(current_server); // vector - adds an element to the end of a vector
                
             } else {
@@ -75,6 +127,9 @@ std::vector<ServerConfig> ConfigParser::    parseConfig(const std::string& filen
                 parseServerDirective(line, current_server);
             }
         }
+        else {
+            parseGlobalDirective(line, global_config);
+        }
     }
     
     file.close();
@@ -101,6 +156,10 @@ bool ConfigParser::validateConfig(const std::vector<ServerConfig>& servers) {
     return true;
 }
 
+const GlobalConfig& ConfigParser::getGlobalConfig() const {
+    return global_config;
+}
+
 // ==================== PARSING HELPERS ====================
 
 std::string ConfigParser::trim(const std::string& str) {
@@ -117,21 +176,60 @@ void ConfigParser::parseServerDirective(const std::string& line, ServerConfig& s
     
     if (directive == "listen") {
         std::string listen_addr;
-        iss >> listen_addr; // Extract the address part (after "listen")
+        iss >> listen_addr; // "8080", "127.0.0.1:8080", "[::1]:8080", "[::]:8080" or "unix:/path"
         
-        size_t colon_pos = listen_addr.find(':'); // From "listen 127.0.0.1:8080;", listen_addr becomes "127.0.0.1:8080;"
-        if (colon_pos != std::string::npos) {
-            server.listen_ip = listen_addr.substr(0, colon_pos); 
-            std::string port_str = listen_addr.substr(colon_pos + 1);
-            std::istringstream port_ss(port_str);
-            port_ss >> server.port;
-        } else {
-            // Only port specified, default to 0.0.0.0
-            std::istringstream port_ss(listen_addr);
-            port_ss >> server.port;
-            server.listen_ip = "0.0.0.0";
+        ListenAddress addr;
+        if (!parseListenAddress(listen_addr, addr)) {
+            std::cout << "Warning: Invalid listen address " << listen_addr << std::endl;
+            return;
         }
         
+        // Optional parameters after the address:
+        // "listen 8080 backlog=1024 deferred fastopen=256 rcvbuf=64k sndbuf=256k"
+        std::string param;
+        while (iss >> param) {
+            if (!param.empty() && param[param.length() - 1] == ';') {
+                param.erase(param.length() - 1);
+            }
+            size_t size;
+            if (param.compare(0, 8, "backlog=") == 0) {
+                if (!parseCount(param.substr(8), addr.backlog) || addr.backlog < 1) {
+                    std::cout << "Warning: Invalid listen " << param << ", using 511" << std::endl;
+                    addr.backlog = 511;
+                }
+            } else if (param.compare(0, 5, "mode=") == 0 && addr.isUnix()) {
+                std::string mode = param.substr(5);
+                if (mode.empty() || mode.length() > 4 || mode.find_first_not_of("01234567") != std::string::npos) {
+                    std::cout << "Warning: Invalid listen " << param << std::endl;
+                } else {
+                    addr.mode = static_cast<int>(std::strtol(mode.c_str(), NULL, 8));
+                }
+            } else if (param == "deferred") {
+                addr.deferred = true;
+            } else if (param.compare(0, 9, "fastopen=") == 0) {
+                if (!parseCount(param.substr(9), addr.fastopen)) {
+                    std::cout << "Warning: Invalid listen " << param << ", fastopen off" << std::endl;
+                    addr.fastopen = 0;
+                }
+            } else if (param.compare(0, 7, "rcvbuf=") == 0 || param.compare(0, 7, "sndbuf=") == 0) {
+                if (!parseSize(param.substr(7), size) || size == 0 || size > 0x7fffffff) {
+                    std::cout << "Warning: Invalid listen " << param << ", using system default" << std::endl;
+                } else if (param[0] == 'r') {
+                    addr.rcvbuf = static_cast<int>(size);
+                } else {
+                    addr.sndbuf = static_cast<int>(size);
+                }
+            } else if (!param.empty()) {
+                std::cout << "Warning: Unknown listen parameter " << param << std::endl;
+            }
+        }
+        
+        // A server block may listen on several addresses; the first one names it in messages
+        if (server.listens.empty()) {
+            server.listen_ip = addr.ip;
+            server.port = addr.port;
+        }
+        server.listens.push_back(addr);
     }
     else if (directive == "server_name") {
         std::string name;
@@ -147,27 +245,16 @@ void ConfigParser::parseServerDirective(const std::string& line, ServerConfig& s
     else if (directive == "client_max_body_size") {
         std::string size_str;
         iss >> size_str;
-        
-        // Parse size with suffixes (K, M, G)
-        char suffix = size_str[size_str.length() - 1];
-        size_t multiplier = 1;
-        std::string num_str = size_str;
-        
-        if (suffix == 'K' || suffix == 'k') {
-            multiplier = 1024;
-            num_str = size_str.substr(0, size_str.length() - 1);
-        } else if (suffix == 'M' || suffix == 'm') {
-            multiplier = 1024 * 1024;
-            num_str = size_str.substr(0, size_str.length() - 1);
-        } else if (suffix == 'G' || suffix == 'g') {
-            multiplier = 1024 * 1024 * 1024;
-            num_str = size_str.substr(0, size_str.length() - 1);
+        if (!parseSize(size_str, server.client_max_body_size)) {
+            std::cout << "Warning: Invalid client_max_body_size " << size_str << std::endl;
         }
-        
-        std::istringstream size_ss(num_str);
-        size_t base_size;
-        size_ss >> base_size;
-        server.client_max_body_size = base_size * multiplier;
+    }
+    else if (directive == "tcp_nodelay" || directive == "tcp_nopush") {
+        std::string value;
+        iss >> value;
+        bool on = (value == "on" || value == "on;");
+        if (directive == "tcp_nodelay") server.tcp_nodelay = on;
+        else server.tcp_nopush = on;
     }
     else if (directive == "error_page") {
         int code;
@@ -194,10 +281,23 @@ void ConfigParser::parseLocationDirective(const std::string& line, Location& loc
         while (iss >> method) {
             if (validateMethod(method)) {
                 location.allowed_methods.push_back(method);
+                HttpMethod id = parseMethod(method.data(), method.size());
+                location.method_mask |= METHOD_BIT(id);
+                if (id == METHOD_GET) {
+                    location.method_mask |= METHOD_BIT(METHOD_HEAD); // RFC 9110 §9.3.2
+                }
             } else {
                 std::cout << "    Warning: Invalid method " << method << std::endl;
             }
         }
+        location.allow_header = "Allow: ";
+        for (size_t i = 0; i < location.allowed_methods.size(); ++i) {
+            if (i) {
+                location.allow_header += ", ";
+            }
+            location.allow_header += location.allowed_methods[i];
+        }
+        location.allow_header += "\r\n";
     }
     else if (directive == "upload_path") {
         iss >> location.upload_path;
@@ -205,11 +305,25 @@ void ConfigParser::parseLocationDirective(const std::string& line, Location& loc
     else if (directive == "root") {
         iss >> location.root;
     }
+    else if (directive == "client_max_body_size") {
+        std::string size_str;
+        iss >> size_str;
+        if (parseSize(size_str, location.client_max_body_size)) {
+            location.has_body_size = true;
+        } else {
+            std::cout << "    Warning: Invalid client_max_body_size " << size_str << std::endl;
+        }
+    }
     else if (directive == "autoindex") {
         std::string value;
         iss >> value;
         location.autoindex = (value == "on" || value == "true");
     }
+    else if (directive == "decompress_request_body") {
+        std::string value;
+        iss >> value;
+        location.decompress_body = (value == "on" || value == "true");
+    }
     else if (directive == "cgi_extension") {
         std::string extension, executor;
         iss >> extension >> executor;
@@ -237,6 +351,258 @@ void ConfigParser::parseLocationDirective(const std::string& line, Location& loc
     }
 }
 
+void ConfigParser::parseGlobalDirective(const std::string& line, GlobalConfig& global) {
+    std::istringstream iss(line);
+    std::string directive;
+    iss >> directive;
+    
+    if (directive == "event_backend") {
+        std::string backend;
+        iss >> backend;
+        if (backend == "auto" || backend == "epoll" || backend == "poll" || backend == "io_uring") {
+            global.event_backend = backend;
+        } else {
+            std::cout << "Warning: Unknown event_backend " << backend << ", using auto" << std::endl;
+        }
+    }
+    else if (directive == "client_header_timeout" || directive == "client_body_timeout" ||
+             directive == "keepalive_timeout" || directive == "send_timeout" ||
+             directive == "lingering_time" || directive == "lingering_timeout") {
+        std::string value;
+        iss >> value;
+        int seconds;
+        if (!parseSeconds(value, seconds)) {
+            std::cout << "Warning: Invalid " << directive << " " << value << std::endl;
+            return;
+        }
+        if (directive == "client_header_timeout") global.client_header_timeout = seconds;
+        else if (directive == "client_body_timeout") global.client_body_timeout = seconds;
+        else if (directive == "keepalive_timeout") global.keepalive_timeout = seconds;
+        else if (directive == "send_timeout") global.send_timeout = seconds;
+        else if (directive == "lingering_time") global.lingering_time = seconds;
+        else global.lingering_timeout = seconds;
+    }
+    else if (directive == "worker_processes") {
+        std::string value;
+        iss >> value;
+        if (!parseCount(value, global.worker_processes) || global.worker_processes < 1) {
+            std::cout << "Warning: Invalid worker_processes " << value << ", using 1" << std::endl;
+            global.worker_processes = 1;
+        }
+    }
+    else if (directive == "reactor_threads") {
+        std::string value;
+        iss >> value;
+        if (!parseCount(value, global.reactor_threads)) {
+            std::cout << "Warning: Invalid reactor_threads " << value << ", using 0" << std::endl;
+            global.reactor_threads = 0;
+        }
+    }
+    else if (directive == "io_budget") {
+        std::string value;
+        iss >> value;
+        if (!parseCount(value, global.io_budget) || global.io_budget < 1) {
+            std::cout << "Warning: Invalid io_budget " << value << ", using 4" << std::endl;
+            global.io_budget = 4;
+        }
+    }
+    else if (directive == "accept_batch") {
+        std::string value;
+        iss >> value;
+        if (!parseCount(value, global.accept_batch) || global.accept_batch < 1) {
+            std::cout << "Warning: Invalid accept_batch " << value << ", using 16" << std::endl;
+            global.accept_batch = 16;
+        }
+    }
+    else if (directive == "read_budget" || directive == "max_read_size") {
+        std::string value;
+        iss >> value;
+        size_t size;
+        // below 4k a header would need several reads
+        if (!parseSize(value, size) || size < 4096) {
+            std::cout << "Warning: Invalid " << directive << " " << value << ", must be at least 4k" << std::endl;
+            return;
+        }
+        if (directive == "read_budget") global.read_budget = size;
+        else global.max_read_size = size;
+    }
+    else if (directive == "large_client_header_buffers") {
+        std::string count, size_str;
+        iss >> count >> size_str;
+        int buffers;
+        size_t size;
+        // a buffer below 1k would not hold an ordinary request line
+        if (!parseCount(count, buffers) || buffers < 1 || !parseSize(size_str, size) || size < 1024) {
+            std::cout << "Warning: Invalid large_client_header_buffers " << count << " " << size_str << std::endl;
+            return;
+        }
+        global.header_buffers = buffers;
+        global.header_buffer_size = size;
+    }
+    else if (directive == "max_request_headers") {
+        std::string value;
+        iss >> value;
+        if (!parseCount(value, global.max_request_headers) || global.max_request_headers < 1) {
+            std::cout << "Warning: Invalid max_request_headers " << value << ", using 100" << std::endl;
+            global.max_request_headers = 100;
+        }
+    }
+    else if (directive == "client_body_buffer_size") {
+        std::string value;
+        iss >> value;
+        size_t size;
+        if (!parseSize(value, size) || size < 1024) {
+            std::cout << "Warning: Invalid client_body_buffer_size " << value << ", must be at least 1k" << std::endl;
+            return;
+        }
+        global.client_body_buffer_size = size;
+    }
+    else if (directive == "client_body_temp_path") {
+        std::string path;
+        iss >> path;
+        if (!path.empty() && path[path.length() - 1] == ';') {
+            path.erase(path.length() - 1);
+        }
+        if (path.empty() || access(path.c_str(), W_OK | X_OK) != 0) {
+            std::cout << "Warning: client_body_temp_path " << path << " is not a writable directory, using "
+                      << global.client_body_temp_path << std::endl;
+            return;
+        }
+        global.client_body_temp_path = path;
+    }
+    else if (directive == "worker_cpu_affinity") {
+        std::string value;
+        iss >> value;
+        global.worker_cpu_affinity = (value == "auto" || value == "on");
+    }
+    else {
+        std::cout << "Warning: Unknown global directive " << directive << std::endl;
+    }
+}
+
+// Accepts a non-negative number or "auto" (number of online CPUs)
+bool ConfigParser::parseCount(const std::string& value, int& out) {
+    if (value == "auto") {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        out = cpus > 0 ? static_cast<int>(cpus) : 1;
+        return true;
+    }
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    out = std::atoi(value.c_str());
+    return true;
+}
+
+// Accepts "port", "ip:port", "[ipv6]:port", "[ipv6]" or "unix:/path" with an optional trailing ';'.
+// The address is stored in numeric form ("localhost" -> 127.0.0.1, "*" -> 0.0.0.0)
+// so it compares equal to what getsockname() reports for accepted clients.
+bool ConfigParser::parseListenAddress(const std::string& value, ListenAddress& out) {
+    std::string spec = value;
+    if (!spec.empty() && spec[spec.length() - 1] == ';') {
+        spec.erase(spec.length() - 1);
+    }
+    if (spec.compare(0, 5, "unix:") == 0) {
+        out.unix_path = spec.substr(5);
+        out.ip.clear();
+        out.port = 0;
+        // sockaddr_un::sun_path is 108 bytes on Linux, 104 on the BSDs
+        return !out.unix_path.empty() && out.unix_path.length() < 104;
+    }
+    std::string host;
+    std::string port_str;
+    if (!spec.empty() && spec[0] == '[') {
+        size_t close = spec.find(']');
+        if (close == std::string::npos) {
+            return false;
+        }
+        host = spec.substr(1, close - 1);
+        if (close + 1 < spec.length()) {
+            if (spec[close + 1] != ':') {
+                return false;
+            }
+            port_str = spec.substr(close + 2);
+        } else {
+            port_str = "80";
+        }
+    } else {
+        size_t colon_pos = spec.rfind(':');
+        if (colon_pos != std::string::npos) {
+            host = spec.substr(0, colon_pos);
+            port_str = spec.substr(colon_pos + 1);
+        } else if (spec.find('.') != std::string::npos) {
+            host = spec; // address only
+            port_str = "80";
+        } else {
+            host = "0.0.0.0"; // only port specified
+            port_str = spec;
+        }
+    }
+    if (port_str.empty() || port_str.find_first_not_of("0123456789") != std::string::npos
+        || port_str.length() > 5) {
+        return false;
+    }
+    out.port = std::atoi(port_str.c_str());
+    if (host == "*" || host.empty()) {
+        host = "0.0.0.0";
+    } else if (host == "localhost") {
+        host = "127.0.0.1";
+    }
+    
+    char buf[INET6_ADDRSTRLEN];
+    struct in_addr v4;
+    struct in6_addr v6;
+    if (inet_pton(AF_INET, host.c_str(), &v4) == 1) {
+        out.ip = inet_ntop(AF_INET, &v4, buf, sizeof(buf));
+    } else if (inet_pton(AF_INET6, host.c_str(), &v6) == 1) {
+        out.ip = inet_ntop(AF_INET6, &v6, buf, sizeof(buf));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Accepts "512", "64k", "8M" or "1G" (binary multiples), with an optional trailing ';'
+bool ConfigParser::parseSize(const std::string& value, size_t& out) {
+    std::string num_str = value;
+    if (!num_str.empty() && num_str[num_str.length() - 1] == ';') {
+        num_str.erase(num_str.length() - 1);
+    }
+    size_t multiplier = 1;
+    char suffix = num_str.empty() ? '\0' : num_str[num_str.length() - 1];
+    if (suffix == 'K' || suffix == 'k') {
+        multiplier = 1024;
+    } else if (suffix == 'M' || suffix == 'm') {
+        multiplier = 1024 * 1024;
+    } else if (suffix == 'G' || suffix == 'g') {
+        multiplier = 1024 * 1024 * 1024;
+    }
+    if (multiplier != 1) {
+        num_str.erase(num_str.length() - 1);
+    }
+    if (num_str.empty() || num_str.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    std::istringstream size_ss(num_str);
+    size_t base_size;
+    size_ss >> base_size;
+    out = base_size * multiplier;
+    return true;
+}
+
+// Accepts "15" or "15s"
+bool ConfigParser::parseSeconds(const std::string& value, int& out) {
+    std::string num_str = value;
+    if (!num_str.empty() && (num_str[num_str.length() - 1] == 's' || num_str[num_str.length() - 1] == 'S')) {
+        num_str = num_str.substr(0, num_str.length() - 1);
+    }
+    if (num_str.empty() || num_str.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    out = std::atoi(num_str.c_str());
+    return out > 0;
+}
+
 // ==================== VALIDATION HELPERS ====================
 
 bool ConfigParser::validatePort(int port) {
@@ -246,6 +612,11 @@ bool ConfigParser::validatePort(int port) {
 bool ConfigParser::validateIP(const std::string& ip) {
     if (ip == "localhost" || ip == "0.0.0.0") return true;
     
+    struct in6_addr v6;
+    if (ip.find(':') != std::string::npos) {
+        return inet_pton(AF_INET6, ip.c_str(), &v6) == 1;
+    }
+    
     // Simple IPv4 validation
     std::istringstream iss(ip);
     std::string octet;
@@ -280,14 +651,23 @@ bool ConfigParser::validateErrorCode(int code) {
 }
 
 bool ConfigParser::validateServerConfig(const ServerConfig& server) {
-    if (!validatePort(server.port)) {
-        std::cout << "Error: Invalid port " << server.port << std::endl;
+    if (server.listens.empty()) {
+        std::cout << "Error: No listen address specified" << std::endl;
         return false;
     }
     
-    if (!validateIP(server.listen_ip)) {
-        std::cout << "Error: Invalid IP " << server.listen_ip << std::endl;
-        return false;
+    for (size_t i = 0; i < server.listens.size(); ++i) {
+        if (server.listens[i].isUnix()) {
+            continue;
+        }
+        if (!validatePort(server.listens[i].port)) {
+            std::cout << "Error: Invalid port " << server.listens[i].port << std::endl;
+            return false;
+        }
+        if (!validateIP(server.listens[i].ip)) {
+            std::cout << "Error: Invalid IP " << server.listens[i].ip << std::endl;
+            return false;
+        }
     }
     
     if (server.root.empty()) {
@@ -316,13 +696,32 @@ bool ConfigParser::checkDuplicatePorts(const std::vector<ServerConfig>& servers)
     bool has_duplicates = false;
     
     for (size_t i = 0; i < servers.size(); ++i) {
-        std::pair<std::string, int> addr(servers[i].listen_ip, servers[i].port);
-        if (used_addresses.find(addr) != used_addresses.end()) {
-            std::cout << "Error: Duplicate listen address " 
-                      << servers[i].listen_ip << ":" << servers[i].port << std::endl;
-            has_duplicates = true;
+        for (size_t j = 0; j < servers[i].listens.size(); ++j) {
+            const ListenAddress& listen = servers[i].listens[j];
+            std::pair<std::string, int> addr(listen.isUnix() ? listen.name() : listen.ip, listen.port);
+            if (used_addresses.find(addr) != used_addresses.end()) {
+                std::cout << "Error: Duplicate listen address " << listen.name() << std::endl;
+                has_duplicates = true;
+            }
+            used_addresses.insert(addr);
+        }
+    }
+    
+    // A specific address under a wildcard on the same port shares the wildcard's
+    // socket, so options of its own could never be applied
+    for (size_t i = 0; i < servers.size(); ++i) {
+        for (size_t j = 0; j < servers[i].listens.size(); ++j) {
+            const ListenAddress& listen = servers[i].listens[j];
+            if (listen.isUnix() || listen.isWildcard() || !listen.hasSocketOptions()) {
+                continue;
+            }
+            std::string any = listen.isIPv6() ? "::" : "0.0.0.0";
+            if (used_addresses.find(std::make_pair(any, listen.port)) != used_addresses.end()) {
+                std::cout << "Error: Duplicate listen options for " << listen.name()
+                          << ", set them on the wildcard listen of port " << listen.port << std::endl;
+                has_duplicates = true;
+            }
         }
-        used_addresses.insert(addr);
     }
     
     if (has_duplicates) {
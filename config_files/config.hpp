@@ -10,38 +10,103 @@
 #include <cstdlib>
 #include <algorithm>
 #include <set>
+#include "../http/HttpMethod.hpp"
+#include "../http/RouteTable.hpp"
 
 struct Location {
     std::string path;
     std::string root;
     std::string index;
     std::vector<std::string> allowed_methods;
+    unsigned int method_mask;  // METHOD_BIT() of each allowed method (GET brings HEAD), 0 = all
+    std::string allow_header;  // "Allow: GET, POST\r\n" for 405 answers, rendered at load
     std::string upload_path;
     bool autoindex;
     std::map<std::string, std::string> cgi_extensions; 
     std::string redirect_url;
     int redirect_code;
+    size_t client_max_body_size; // overrides the server's when has_body_size
+    bool has_body_size;
+    bool decompress_body; // decompress_request_body: inflate gzip / deflate bodies, off passes them through
     
-    Location() : autoindex(false), redirect_code(0) {}
+    Location() : method_mask(0), autoindex(false), redirect_code(0), client_max_body_size(0), has_body_size(false),
+        decompress_body(true) {}
+};
+
+// One "listen" directive: the address a listening socket is bound to
+struct ListenAddress {
+    std::string ip;  // numeric form, "0.0.0.0" or "::" for any address
+    int port;
+    std::string unix_path; // "listen unix:/path": ip and port stay empty
+    int mode;        // unix socket permissions ("mode=0660"), -1 = leave as created
+    int fd;          // unix socket bound by the master before fork, -1 = bind our own
+    int backlog;     // listen queue length, "listen ... backlog=N"
+    bool deferred;   // TCP_DEFER_ACCEPT: wake us only once the request has data
+    int fastopen;    // TCP_FASTOPEN queue length, 0 = off
+    int rcvbuf;      // SO_RCVBUF / SO_SNDBUF in bytes, 0 = system default;
+    int sndbuf;      // accepted sockets inherit them from the listener
+    
+    ListenAddress();
+    bool isWildcard() const;
+    bool isIPv6() const;
+    bool isUnix() const;
+    bool hasSocketOptions() const; // backlog, deferred, fastopen, rcvbuf or sndbuf was given
+    std::string name() const; // "ip:port", "[ipv6]:port" or "unix:/path"
 };
 
 struct ServerConfig {
-    std::string listen_ip;
+    std::string listen_ip; // first listen directive, kept for messages
     int port;
+    std::vector<ListenAddress> listens;
     std::vector<std::string> server_names;
     std::string root;
     size_t client_max_body_size;
+    bool tcp_nodelay;  // disable Nagle on accepted sockets
+    bool tcp_nopush;   // TCP_CORK while headers + a file body go out, so they share segments
     std::map<int, std::string> error_pages;
     std::vector<Location> locations;
+    RouteTable routes; // location paths -> index in locations, longest prefix wins
     
     ServerConfig();
 };
 
+// Directives that live outside any server block (one set per process)
+struct GlobalConfig {
+    std::string event_backend; // auto | epoll | poll | io_uring
+    int client_header_timeout; // seconds to receive a whole request header
+    int client_body_timeout;   // seconds allowed between two reads of a body
+    int keepalive_timeout;     // seconds an idle keep-alive connection stays open
+    int send_timeout;          // seconds allowed between two successful sends
+    int lingering_time;        // seconds a refused client's input is drained before closing
+    int lingering_timeout;     // seconds without input that end the draining early
+    int worker_processes;      // > 1 forks that many workers (master/worker mode)
+    bool worker_cpu_affinity;  // pin worker N to CPU N
+    int reactor_threads;       // > 0: one acceptor thread feeding that many reactor threads
+    int io_budget;             // socket reads + writes one connection may do per loop iteration
+    int accept_batch;          // connections taken from one ready listener per loop iteration
+    size_t read_budget;        // bytes one connection may read per loop iteration
+    size_t max_read_size;      // largest single recv() a streaming connection grows to
+    int header_buffers;        // large_client_header_buffers N SIZE: the request line and each
+    size_t header_buffer_size; // header line fit in SIZE, the whole header block in N * SIZE
+    int max_request_headers;   // header lines per request
+    size_t client_body_buffer_size;    // a larger request body is spilled to a temp file
+    std::string client_body_temp_path; // directory of those files (unlinked right away)
+    
+    GlobalConfig();
+};
+
 class ConfigParser {
 private:
+    GlobalConfig global_config;
+    
     std::string trim(const std::string& str);
     void parseServerDirective(const std::string& line, ServerConfig& server);
     void parseLocationDirective(const std::string& line, Location& location);
+    void parseGlobalDirective(const std::string& line, GlobalConfig& global);
+    bool parseSeconds(const std::string& value, int& out);
+    bool parseCount(const std::string& value, int& out);
+    bool parseListenAddress(const std::string& value, ListenAddress& out);
+    bool parseSize(const std::string& value, size_t& out);
     
     // Validation methods
     bool validatePort(int port);
@@ -57,6 +122,7 @@ private:
 public:
     std::vector<ServerConfig> parseConfig(const std::string& filename);
     bool validateConfig(const std::vector<ServerConfig>& servers);
+    const GlobalConfig& getGlobalConfig() const;
 };
 
 #endif
\ No newline at end of file
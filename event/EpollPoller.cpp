@@ -0,0 +1,96 @@
+#include "EpollPoller.hpp"
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <cstring>
+
+EpollPoller::EpollPoller():
+	_epfd(epoll_create1(EPOLL_CLOEXEC)),
+	_events(EPOLL_MAX_EVENTS)
+{}
+
+EpollPoller::~EpollPoller()
+{
+	if (_epfd >= 0)
+		close(_epfd);
+}
+
+bool	EpollPoller::isValid() const
+{
+	return (_epfd >= 0);
+}
+
+unsigned int	EpollPoller::toEpoll(short events)
+{
+	unsigned int	out = 0;
+	if (events & POLLIN)
+		out |= EPOLLIN;
+	if (events & POLLOUT)
+		out |= EPOLLOUT;
+	return (out);
+}
+
+short	EpollPoller::fromEpoll(unsigned int events)
+{
+	short	out = 0;
+	if (events & EPOLLIN)
+		out |= POLLIN;
+	if (events & EPOLLOUT)
+		out |= POLLOUT;
+	if (events & EPOLLERR)
+		out |= POLLERR;
+	if (events & EPOLLHUP)
+		out |= POLLHUP;
+	return (out);
+}
+
+bool	EpollPoller::add(int fd, short events)
+{
+	struct epoll_event	ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = toEpoll(events);
+	ev.data.fd = fd;
+	return (epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == 0);
+}
+
+bool	EpollPoller::modify(int fd, short events)
+{
+	struct epoll_event	ev;
+	std::memset(&ev, 0, sizeof(ev));
+	ev.events = toEpoll(events);
+	ev.data.fd = fd;
+	return (epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == 0);
+}
+
+void	EpollPoller::remove(int fd)
+{
+	// must run before close(): a closed fd silently leaves the interest set anyway,
+	// but a dup'ed one (e.g. inherited by a CGI child) would not
+	struct epoll_event	ev;
+	std::memset(&ev, 0, sizeof(ev));
+	epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int	EpollPoller::wait(std::vector<PollEvent> &ready, int timeout_ms)
+{
+	ready.clear();
+	int	count = epoll_wait(_epfd, &_events[0], static_cast<int>(_events.size()), timeout_ms);
+	if (count <= 0)
+		return (count);
+	for (int i = 0; i < count; ++i)
+	{
+		PollEvent	ev;
+		ev.fd = _events[i].data.fd;
+		ev.events = fromEpoll(_events[i].events);
+		ready.push_back(ev);
+	}
+	return (count);
+}
+
+const char	*EpollPoller::name() const
+{
+	return ("epoll");
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef EPOLLPOLLER_HPP
+# define EPOLLPOLLER_HPP
+
+#include "EventPoller.hpp"
+
+#ifdef __linux__
+
+# include <sys/epoll.h>
+
+# define EPOLL_MAX_EVENTS 1024
+
+/*
+	Linux backend: the kernel keeps the interest set, wait() only returns ready fds,
+	so a tick costs O(ready) instead of O(connections).
+*/
+class	EpollPoller: public EventPoller
+{
+	private:
+		int	_epfd;
+		std::vector<struct epoll_event>	_events;
+
+		static unsigned int	toEpoll(short events);
+		static short	fromEpoll(unsigned int events);
+
+	public:
+		EpollPoller();
+		~EpollPoller();
+
+		bool	isValid() const;
+		bool	add(int fd, short events);
+		bool	modify(int fd, short events);
+		void	remove(int fd);
+		int		wait(std::vector<PollEvent> &ready, int timeout_ms);
+		const char	*name() const;
+};
+
+#endif
+
+#endif
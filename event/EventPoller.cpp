@@ -0,0 +1,67 @@
+#include "EventPoller.hpp"
+#include "PollPoller.hpp"
+#include "EpollPoller.hpp"
+#include "UringPoller.hpp"
+#include <iostream>
+
+PollEvent::PollEvent():
+	fd(-1), events(0), kind(EVENT_READY), result(0), data(NULL), tag(0)
+{}
+
+EventPoller::EventPoller() {}
+
+EventPoller::~EventPoller() {}
+
+bool	EventPoller::completionBased() const
+{
+	return (false);
+}
+
+bool	EventPoller::watchListener(int fd)
+{
+	return (add(fd, POLLIN));
+}
+
+bool	EventPoller::watchClient(int fd)
+{
+	return (add(fd, POLLIN));
+}
+
+bool	EventPoller::submitSend(int fd, std::vector<std::string> &buffers)
+{
+	(void)fd;
+	(void)buffers;
+	return (false);
+}
+
+bool	EventPoller::isStale(const PollEvent &ev) const
+{
+	(void)ev;
+	return (false);
+}
+
+EventPoller *EventPoller::create(const std::string &backend)
+{
+#ifdef __linux__
+	if (backend == "io_uring")
+	{
+		UringPoller	*uring = new UringPoller();
+		if (uring->isValid())
+			return (uring);
+		delete uring;
+		std::cerr << "io_uring unavailable, falling back to epoll" << std::endl;
+	}
+	if (backend == "io_uring" || backend == "auto" || backend == "epoll" || backend.empty())
+	{
+		EpollPoller	*epoller = new EpollPoller();
+		if (epoller->isValid())
+			return (epoller);
+		delete epoller;
+		std::cerr << "epoll unavailable, falling back to poll" << std::endl;
+	}
+#else
+	if (backend == "epoll" || backend == "io_uring")
+		std::cerr << "epoll is not supported on this platform, falling back to poll" << std::endl;
+#endif
+	return (new PollPoller());
+}
@@ -0,0 +1,75 @@
+#ifndef EVENTPOLLER_HPP
+# define EVENTPOLLER_HPP
+
+#include <vector>
+#include <string>
+#include <poll.h>
+
+/*
+	What a PollEvent reports.
+	Readiness backends (poll, epoll) only produce EVENT_READY; a completion backend
+	(io_uring) has already done the accept/recv/send and hands back its result.
+*/
+enum EventKind
+{
+	EVENT_READY,	// fd is ready, see events
+	EVENT_ACCEPTED,	// fd is a listener, result is the accepted client fd (or < 0)
+	EVENT_RECEIVED,	// data/result hold what was read: 0 = peer closed, < 0 = error
+	EVENT_SENT,		// an earlier submitSend finished: bytes sent, or < 0 on failure
+	EVENT_SEND_PROGRESS	// part of a submitSend went out (result bytes), more is still in flight
+};
+
+/*
+	One ready file descriptor as reported by a backend.
+	events always uses the poll() vocabulary (POLLIN, POLLOUT, POLLERR, POLLHUP, POLLNVAL)
+	so Server::run dispatches the same way whatever backend produced it.
+*/
+struct PollEvent
+{
+	int		fd;
+	short	events;
+	int		kind;
+	long	result;
+	const char	*data; // EVENT_RECEIVED: valid until the next wait()
+	unsigned int	tag; // backend bookkeeping, see isStale()
+
+	PollEvent();
+};
+
+/*
+	Readiness backend used by Server::run.
+	Level-triggered on every backend: an fd keeps being reported while it stays ready.
+*/
+class	EventPoller
+{
+	private:
+		EventPoller(const EventPoller &other);
+		EventPoller	&operator=(const EventPoller &other);
+
+	protected:
+		EventPoller();
+
+	public:
+		virtual ~EventPoller();
+
+		virtual bool	add(int fd, short events) = 0;
+		virtual bool	modify(int fd, short events) = 0;
+		virtual void	remove(int fd) = 0;
+		// Fill ready with the fds that have events; returns how many, or -1 on failure
+		virtual int		wait(std::vector<PollEvent> &ready, int timeout_ms) = 0;
+		virtual const char	*name() const = 0;
+
+		// Completion-style hooks; readiness backends keep the defaults
+		virtual bool	completionBased() const;
+		virtual bool	watchListener(int fd); // default: add(fd, POLLIN)
+		virtual bool	watchClient(int fd); // default: add(fd, POLLIN)
+		// Takes the buffers (swapped out, left empty) and sends them in order; EVENT_SENT follows
+		virtual bool	submitSend(int fd, std::vector<std::string> &buffers);
+		// true if ev belongs to an fd that was removed after the event was collected
+		virtual bool	isStale(const PollEvent &ev) const;
+
+		// backend: "auto", "epoll", "poll" or "io_uring" (falls back to epoll, then poll, if unavailable)
+		static EventPoller	*create(const std::string &backend);
+};
+
+#endif
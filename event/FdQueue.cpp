@@ -0,0 +1,41 @@
+#include "FdQueue.hpp"
+
+static size_t	roundUpPow2(size_t n)
+{
+	size_t	p = 1;
+	while (p < n)
+		p <<= 1;
+	return (p);
+}
+
+FdQueue::FdQueue(size_t capacity):
+	_ring(roundUpPow2(capacity), -1),
+	_mask(roundUpPow2(capacity) - 1),
+	_head(0),
+	_tail(0)
+{}
+
+FdQueue::~FdQueue() {}
+
+bool	FdQueue::push(int fd)
+{
+	size_t	tail = _tail;
+	size_t	head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+	if (tail - head == _ring.size())
+		return (false);
+	_ring[tail & _mask] = fd;
+	// publish the slot before the new tail becomes visible to the consumer
+	__atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+	return (true);
+}
+
+bool	FdQueue::pop(int &fd)
+{
+	size_t	head = _head;
+	size_t	tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+	if (head == tail)
+		return (false);
+	fd = _ring[head & _mask];
+	__atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+	return (true);
+}
@@ -0,0 +1,32 @@
+#ifndef FDQUEUE_HPP
+# define FDQUEUE_HPP
+
+#include <vector>
+#include <cstddef>
+
+/*
+	Lock-free single-producer / single-consumer ring of fds.
+	The acceptor thread is the only producer and one reactor thread the only consumer,
+	so head and tail each have a single writer and only need acquire/release ordering.
+*/
+class	FdQueue
+{
+	private:
+		std::vector<int>	_ring;
+		size_t	_mask;
+		size_t	_head; // next slot to pop, written by the consumer only
+		size_t	_tail; // next slot to push, written by the producer only
+
+		FdQueue(const FdQueue &other);
+		FdQueue	&operator=(const FdQueue &other);
+
+	public:
+		// capacity is rounded up to a power of two
+		explicit FdQueue(size_t capacity);
+		~FdQueue();
+
+		bool	push(int fd); // false when full
+		bool	pop(int &fd); // false when empty
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "OutputChain.hpp"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+#endif
+
+#define FILE_CHUNK 65536 // bytes read per send when sendfile is not available
+
+OutputChain::OutputChain(): _bytes(0), _files(0) {}
+
+OutputChain::OutputChain(const OutputChain &other): _segments(other._segments), _bytes(other._bytes),
+	_files(other._files)
+{
+	for (size_t i = 0; i < _segments.size(); ++i)
+		retain(_segments[i]);
+}
+
+OutputChain	&OutputChain::operator=(const OutputChain &other)
+{
+	if (this != &other)
+	{
+		// retain first: other may share our buffers
+		for (size_t i = 0; i < other._segments.size(); ++i)
+			retain(other._segments[i]);
+		clear();
+		_segments = other._segments;
+		_bytes = other._bytes;
+		_files = other._files;
+	}
+	return (*this);
+}
+
+OutputChain::~OutputChain()
+{
+	clear();
+}
+
+void	OutputChain::retain(const Segment &seg)
+{
+	if (seg.buffer)
+		++seg.buffer->refs;
+	else
+		++seg.file->refs;
+}
+
+void	OutputChain::release(const Segment &seg)
+{
+	if (seg.buffer)
+	{
+		if (--seg.buffer->refs == 0)
+			delete seg.buffer;
+	}
+	else if (--seg.file->refs == 0)
+	{
+		close(seg.file->fd);
+		delete seg.file;
+	}
+}
+
+void	OutputChain::pushBuffer(Buffer *buf)
+{
+	Segment	seg;
+	seg.buffer = buf;
+	seg.file = NULL;
+	seg.offset = 0;
+	seg.length = buf->data.size();
+	_segments.push_back(seg);
+	_bytes += seg.length;
+}
+
+void	OutputChain::append(const std::string &data)
+{
+	if (data.empty())
+		return;
+	Buffer	*buf = new Buffer();
+	buf->data = data;
+	buf->refs = 1;
+	pushBuffer(buf);
+}
+
+void	OutputChain::take(std::string &data)
+{
+	if (data.empty())
+		return;
+	Buffer	*buf = new Buffer();
+	buf->data.swap(data);
+	buf->refs = 1;
+	pushBuffer(buf);
+}
+
+void	OutputChain::appendFile(int fd, off_t offset, size_t length)
+{
+	if (length == 0)
+	{
+		close(fd);
+		return;
+	}
+	Segment	seg;
+	seg.buffer = NULL;
+	seg.file = new File();
+	seg.file->fd = fd;
+	seg.file->refs = 1;
+	seg.offset = offset;
+	seg.length = length;
+	_segments.push_back(seg);
+	_bytes += length;
+	++_files;
+}
+
+bool	OutputChain::empty() const
+{
+	return (_bytes == 0);
+}
+
+size_t	OutputChain::size() const
+{
+	return (_bytes);
+}
+
+bool	OutputChain::hasFile() const
+{
+	return (_files > 0);
+}
+
+/*
+	A file range at the front goes out with sendfile (kernel to socket, no copy);
+	otherwise every buffer segment up to the next file range is gathered into one writev.
+*/
+ssize_t	OutputChain::flush(int fd)
+{
+	if (_segments.empty())
+		return (0);
+	const Segment	&front = _segments.front();
+	ssize_t	n;
+	if (front.file)
+	{
+#ifdef __linux__
+		off_t	offset = front.offset;
+		n = sendfile(fd, front.file->fd, &offset, front.length);
+#else
+		char	chunk[FILE_CHUNK];
+		size_t	want = front.length < sizeof(chunk) ? front.length : sizeof(chunk);
+		n = pread(front.file->fd, chunk, want, front.offset);
+		if (n > 0)
+			n = send(fd, chunk, static_cast<size_t>(n), 0);
+#endif
+	}
+	else
+	{
+		struct iovec	iov[OUTPUT_MAX_IOV];
+		int	count = 0;
+		for (size_t i = 0; i < _segments.size() && count < OUTPUT_MAX_IOV; ++i)
+		{
+			const Segment	&seg = _segments[i];
+			if (seg.file)
+				break;
+			iov[count].iov_base = const_cast<char *>(seg.buffer->data.data()) + seg.offset;
+			iov[count].iov_len = seg.length;
+			++count;
+		}
+		n = writev(fd, iov, count);
+	}
+	if (n > 0)
+		consume(static_cast<size_t>(n));
+	return (n);
+}
+
+/*
+	Advance the cursor by n sent bytes, dropping fully sent segments
+*/
+void	OutputChain::consume(size_t n)
+{
+	if (n > _bytes)
+		n = _bytes;
+	_bytes -= n;
+	while (n > 0)
+	{
+		Segment	&seg = _segments.front();
+		if (n < seg.length)
+		{
+			seg.offset += static_cast<off_t>(n);
+			seg.length -= n;
+			return;
+		}
+		n -= seg.length;
+		if (seg.file)
+			--_files;
+		release(seg);
+		_segments.pop_front();
+	}
+}
+
+/*
+	For senders that need plain memory (the io_uring backend).
+	A whole, unshared buffer is swapped out instead of copied.
+	File ranges are read in at most maxFile bytes per call and the rest stays
+	queued, so a download holds one window in memory, not the whole file;
+	the caller drains again once those bytes are sent.
+	false if a file range could not be read.
+*/
+bool	OutputChain::drainTo(std::vector<std::string> &out, size_t maxFile)
+{
+	while (!_segments.empty())
+	{
+		Segment	&seg = _segments.front();
+		if (seg.buffer)
+		{
+			out.push_back(std::string());
+			if (seg.buffer->refs == 1 && seg.offset == 0 && seg.length == seg.buffer->data.size())
+				out.back().swap(seg.buffer->data);
+			else
+				out.back().assign(seg.buffer->data, static_cast<size_t>(seg.offset), seg.length);
+			consume(seg.length);
+			continue;
+		}
+		if (maxFile == 0)
+			break;
+		size_t	want = seg.length < maxFile ? seg.length : maxFile;
+		out.push_back(std::string());
+		std::string	&dst = out.back();
+		dst.resize(want);
+		size_t	done = 0;
+		while (done < want)
+		{
+			ssize_t	n = pread(seg.file->fd, &dst[done], want - done, seg.offset + static_cast<off_t>(done));
+			if (n <= 0)
+			{
+				clear();
+				return (false);
+			}
+			done += static_cast<size_t>(n);
+		}
+		maxFile -= want;
+		consume(want);
+	}
+	return (true);
+}
+
+void	OutputChain::clear()
+{
+	for (size_t i = 0; i < _segments.size(); ++i)
+		release(_segments[i]);
+	_segments.clear();
+	_bytes = 0;
+	_files = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef OUTPUTCHAIN_HPP
+# define OUTPUTCHAIN_HPP
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <sys/types.h>
+
+# define OUTPUT_MAX_IOV 64 // buffer segments gathered into one writev
+# define OUTPUT_FILE_WINDOW (256 * 1024) // file bytes drainTo reads in per call
+
+/*
+	What a connection still has to send: an ordered list of segments, each a slice
+	of a shared in-memory buffer or a range of an open file.
+	A partial send only moves the front segment's offset, nothing is copied or moved,
+	and consecutive buffer segments (pipelined responses) leave in one writev.
+	Buffers and files are reference counted so segments can share them; the counts
+	are not atomic, a chain belongs to one event loop.
+*/
+class	OutputChain
+{
+	private:
+		struct Buffer
+		{
+			std::string	data;
+			int	refs;
+		};
+		struct File
+		{
+			int	fd;
+			int	refs;
+		};
+		struct Segment
+		{
+			Buffer	*buffer; // exactly one of buffer / file is set
+			File	*file;
+			off_t	offset; // consumption cursor into the buffer or file
+			size_t	length; // bytes left from offset
+		};
+
+		std::deque<Segment>	_segments;
+		size_t	_bytes;
+		size_t	_files; // file segments in the chain
+
+		static void	retain(const Segment &seg);
+		static void	release(const Segment &seg);
+		void	pushBuffer(Buffer *buf);
+
+	public:
+		OutputChain();
+		OutputChain(const OutputChain &other);
+		OutputChain	&operator=(const OutputChain &other);
+		~OutputChain();
+
+		void	append(const std::string &data); // copies data
+		void	take(std::string &data); // no copy, data is left empty
+		void	appendFile(int fd, off_t offset, size_t length); // the chain owns fd from here on
+
+		bool	empty() const;
+		size_t	size() const;
+		bool	hasFile() const;
+
+		// One writev (or sendfile for a file range at the front); returns send()'s result
+		ssize_t	flush(int fd);
+		void	consume(size_t n);
+		// Move queued bytes into plain strings, reading at most maxFile bytes of file ranges
+		bool	drainTo(std::vector<std::string> &out, size_t maxFile);
+		void	clear();
+};
+
+#endif
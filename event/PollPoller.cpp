@@ -0,0 +1,73 @@
+#include "PollPoller.hpp"
+
+PollPoller::PollPoller() {}
+
+PollPoller::~PollPoller() {}
+
+int	PollPoller::findSlot(int fd) const
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _slots.size())
+		return (-1);
+	return (_slots[fd]);
+}
+
+bool	PollPoller::add(int fd, short events)
+{
+	if (fd < 0 || findSlot(fd) >= 0)
+		return (false);
+	struct pollfd	pfd;
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	if (static_cast<size_t>(fd) >= _slots.size())
+		_slots.resize(fd + 1, -1);
+	_slots[fd] = static_cast<int>(_pfds.size());
+	_pfds.push_back(pfd);
+	return (true);
+}
+
+bool	PollPoller::modify(int fd, short events)
+{
+	int	slot = findSlot(fd);
+	if (slot < 0)
+		return (false);
+	_pfds[slot].events = events;
+	return (true);
+}
+
+void	PollPoller::remove(int fd)
+{
+	int	slot = findSlot(fd);
+	if (slot < 0)
+		return;
+	// swap-and-pop instead of erase(), so removal does not shift the array
+	_pfds[slot] = _pfds.back();
+	_slots[_pfds[slot].fd] = slot;
+	_pfds.pop_back();
+	_slots[fd] = -1;
+}
+
+int	PollPoller::wait(std::vector<PollEvent> &ready, int timeout_ms)
+{
+	ready.clear();
+	int	count = poll(_pfds.data(), _pfds.size(), timeout_ms);
+	if (count <= 0)
+		return (count);
+	// poll() has no ready list, so collect the entries with revents set
+	for (size_t i = 0; i < _pfds.size() && static_cast<int>(ready.size()) < count; ++i)
+	{
+		if (_pfds[i].revents == 0)
+			continue;
+		PollEvent	ev;
+		ev.fd = _pfds[i].fd;
+		ev.events = _pfds[i].revents;
+		ready.push_back(ev);
+		_pfds[i].revents = 0;
+	}
+	return (static_cast<int>(ready.size()));
+}
+
+const char	*PollPoller::name() const
+{
+	return ("poll");
+}
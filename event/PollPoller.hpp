@@ -0,0 +1,28 @@
+#ifndef POLLPOLLER_HPP
+# define POLLPOLLER_HPP
+
+#include "EventPoller.hpp"
+
+/*
+	Portable backend: one poll() over every registered fd per wait.
+*/
+class	PollPoller: public EventPoller
+{
+	private:
+		std::vector<struct pollfd>	_pfds;
+		std::vector<int>	_slots; // indexed by fd: position in _pfds, -1 if not registered
+
+		int	findSlot(int fd) const;
+
+	public:
+		PollPoller();
+		~PollPoller();
+
+		bool	add(int fd, short events);
+		bool	modify(int fd, short events);
+		void	remove(int fd);
+		int		wait(std::vector<PollEvent> &ready, int timeout_ms);
+		const char	*name() const;
+};
+
+#endif
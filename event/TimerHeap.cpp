@@ -0,0 +1,113 @@
+#include "TimerHeap.hpp"
+#include <ctime>
+
+TimerHeap::TimerHeap() {}
+
+TimerHeap::~TimerHeap() {}
+
+long long	TimerHeap::nowMs()
+{
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000);
+}
+
+void	TimerHeap::place(size_t i, const Entry &e)
+{
+	_heap[i] = e;
+	_pos[e.fd] = static_cast<int>(i);
+}
+
+void	TimerHeap::siftUp(size_t i)
+{
+	Entry	e = _heap[i];
+	while (i > 0)
+	{
+		size_t	parent = (i - 1) / 2;
+		if (_heap[parent].deadline <= e.deadline)
+			break;
+		place(i, _heap[parent]);
+		i = parent;
+	}
+	place(i, e);
+}
+
+void	TimerHeap::siftDown(size_t i)
+{
+	Entry	e = _heap[i];
+	size_t	n = _heap.size();
+	while (true)
+	{
+		size_t	child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && _heap[child + 1].deadline < _heap[child].deadline)
+			++child;
+		if (e.deadline <= _heap[child].deadline)
+			break;
+		place(i, _heap[child]);
+		i = child;
+	}
+	place(i, e);
+}
+
+void	TimerHeap::removeAt(size_t i)
+{
+	int	fd = _heap[i].fd;
+	Entry	last = _heap.back();
+	_heap.pop_back();
+	_pos[fd] = -1;
+	if (i == _heap.size())
+		return;
+	place(i, last);
+	siftDown(i);
+	siftUp(_pos[last.fd]);
+}
+
+void	TimerHeap::schedule(int fd, long long deadline)
+{
+	if (fd < 0)
+		return;
+	if (static_cast<size_t>(fd) >= _pos.size())
+		_pos.resize(fd + 1, -1);
+	Entry	e;
+	e.deadline = deadline;
+	e.fd = fd;
+	if (_pos[fd] >= 0)
+	{
+		size_t	i = _pos[fd];
+		place(i, e);
+		siftDown(i);
+		siftUp(_pos[fd]);
+		return;
+	}
+	_heap.push_back(e);
+	_pos[fd] = static_cast<int>(_heap.size() - 1);
+	siftUp(_heap.size() - 1);
+}
+
+void	TimerHeap::cancel(int fd)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _pos.size() || _pos[fd] < 0)
+		return;
+	removeAt(_pos[fd]);
+}
+
+bool	TimerHeap::empty() const
+{
+	return (_heap.empty());
+}
+
+long long	TimerHeap::nextDeadline() const
+{
+	return (_heap[0].deadline);
+}
+
+int	TimerHeap::popExpired(long long now)
+{
+	if (_heap.empty() || _heap[0].deadline > now)
+		return (-1);
+	int	fd = _heap[0].fd;
+	removeAt(0);
+	return (fd);
+}
@@ -0,0 +1,43 @@
+#ifndef TIMERHEAP_HPP
+# define TIMERHEAP_HPP
+
+#include <vector>
+#include <cstddef>
+
+/*
+	Deadlines keyed by fd, kept in a binary min-heap with an fd -> heap position index.
+	schedule/cancel are O(log n), the nearest deadline is O(1), and expiring costs
+	O(log n) per expired fd: nothing is scanned that is not due.
+*/
+class	TimerHeap
+{
+	private:
+		struct Entry
+		{
+			long long	deadline; // ms, monotonic clock
+			int			fd;
+		};
+		std::vector<Entry>	_heap;
+		std::vector<int>	_pos; // indexed by fd: position in _heap, -1 if not scheduled
+
+		void	place(size_t i, const Entry &e);
+		void	siftUp(size_t i);
+		void	siftDown(size_t i);
+		void	removeAt(size_t i);
+
+	public:
+		TimerHeap();
+		~TimerHeap();
+
+		// (Re)arm fd's deadline, replacing any earlier one
+		void	schedule(int fd, long long deadline);
+		void	cancel(int fd);
+		bool	empty() const;
+		long long	nextDeadline() const; // only valid when !empty()
+		// Pop one fd whose deadline is <= now, -1 when none is due
+		int		popExpired(long long now);
+
+		static long long	nowMs();
+};
+
+#endif
@@ -0,0 +1,565 @@
+#include "UringPoller.hpp"
+
+#ifdef __linux__
+
+#include <linux/time_types.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+// user_data layout: op in the top 4 bits, fd generation below it, fd (or send slot) in the low 32
+#define OP_ACCEPT 1ULL
+#define OP_RECV 2ULL
+#define OP_POLL 3ULL
+#define OP_CANCEL 4ULL
+#define OP_SEND 5ULL
+#define GEN_MASK 0x0FFFFFFFU
+
+static unsigned long long	packData(unsigned long long op, unsigned int gen, unsigned int low)
+{
+	return ((op << 60) | (static_cast<unsigned long long>(gen & GEN_MASK) << 32) | low);
+}
+
+UringPoller::UringPoller():
+	_ringfd(-1), _valid(false),
+	_sqMap(MAP_FAILED), _sqMapLen(0), _sqHead(NULL), _sqTail(NULL), _sqMask(NULL), _sqArray(NULL),
+	_sqEntries(0), _sqes(NULL), _sqesLen(0), _sqLocalTail(0),
+	_cqHead(NULL), _cqTail(NULL), _cqMask(NULL), _cqes(NULL),
+	_bufRing(NULL), _bufBase(NULL), _bufTail(0)
+{
+	_valid = setup() && probe() && setupBufferRing();
+}
+
+UringPoller::~UringPoller()
+{
+	// closing the ring cancels whatever is still in flight
+	if (_ringfd >= 0)
+		close(_ringfd);
+	if (_sqes)
+		munmap(_sqes, _sqesLen);
+	if (_sqMap != MAP_FAILED)
+		munmap(_sqMap, _sqMapLen);
+	free(_bufRing);
+	delete[] _bufBase;
+	for (size_t i = 0; i < _sends.size(); ++i)
+		delete _sends[i];
+}
+
+bool	UringPoller::isValid() const
+{
+	return (_valid);
+}
+
+/*
+	Create the ring and map its queues
+*/
+bool	UringPoller::setup()
+{
+	struct io_uring_params	params;
+	std::memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = URING_CQ_ENTRIES;
+	_ringfd = static_cast<int>(syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params));
+	if (_ringfd < 0)
+		return (false);
+	// single mmap for both rings, no dropped completions, timeout on enter
+	const unsigned int	needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	if ((params.features & needed) != needed)
+		return (false);
+
+	_sqEntries = params.sq_entries;
+	size_t	sqLen = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	size_t	cqLen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	_sqMapLen = sqLen > cqLen ? sqLen : cqLen;
+	_sqMap = mmap(NULL, _sqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringfd, IORING_OFF_SQ_RING);
+	if (_sqMap == MAP_FAILED)
+		return (false);
+	_sqesLen = params.sq_entries * sizeof(struct io_uring_sqe);
+	void	*sqes = mmap(NULL, _sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringfd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		return (false);
+	_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+	char	*sq = static_cast<char *>(_sqMap);
+	_sqHead = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+	_sqTail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+	_sqMask = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+	_sqArray = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+	_sqLocalTail = *_sqTail;
+	// IORING_FEAT_SINGLE_MMAP: the completion ring lives in the same mapping
+	_cqHead = reinterpret_cast<unsigned int *>(sq + params.cq_off.head);
+	_cqTail = reinterpret_cast<unsigned int *>(sq + params.cq_off.tail);
+	_cqMask = reinterpret_cast<unsigned int *>(sq + params.cq_off.ring_mask);
+	_cqes = reinterpret_cast<struct io_uring_cqe *>(sq + params.cq_off.cqes);
+	return (true);
+}
+
+/*
+	Every opcode we use must be supported, and multishot recv needs Linux 6.0
+	(the probe cannot tell that one apart, so check the release).
+*/
+bool	UringPoller::probe()
+{
+	const unsigned int	opCount = 256;
+	std::vector<char>	mem(sizeof(struct io_uring_probe) + opCount * sizeof(struct io_uring_probe_op), 0);
+	struct io_uring_probe	*pr = reinterpret_cast<struct io_uring_probe *>(&mem[0]);
+	if (syscall(__NR_io_uring_register, _ringfd, IORING_REGISTER_PROBE, pr, opCount) < 0)
+		return (false);
+	const int	ops[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL };
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i)
+	{
+		if (ops[i] > pr->last_op || !(pr->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+			return (false);
+	}
+
+	struct utsname	uts;
+	int	major = 0;
+	int	minor = 0;
+	if (uname(&uts) != 0 || sscanf(uts.release, "%d.%d", &major, &minor) != 2)
+		return (false);
+	return (major >= 6);
+}
+
+/*
+	Register URING_BUF_COUNT receive buffers as group 0; multishot recv takes one per completion
+*/
+bool	UringPoller::setupBufferRing()
+{
+	size_t	ringLen = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+	void	*mem = NULL;
+	if (posix_memalign(&mem, static_cast<size_t>(sysconf(_SC_PAGESIZE)), ringLen) != 0)
+		return (false);
+	std::memset(mem, 0, ringLen);
+	_bufRing = static_cast<struct io_uring_buf *>(mem);
+	_bufBase = new char[URING_BUF_COUNT * URING_BUF_SIZE];
+
+	struct io_uring_buf_reg	reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uintptr_t>(mem);
+	reg.ring_entries = URING_BUF_COUNT;
+	reg.bgid = 0;
+	if (syscall(__NR_io_uring_register, _ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		return (false);
+	for (unsigned short bid = 0; bid < URING_BUF_COUNT; ++bid)
+		_lent.push_back(bid);
+	recycleBuffers();
+	return (true);
+}
+
+/*
+	Next free submission slot, NULL if the queue stays full even after flushing it
+*/
+struct io_uring_sqe	*UringPoller::getSqe()
+{
+	if (_sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+	{
+		enter(0, -1);
+		if (_sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+			return (NULL);
+	}
+	unsigned int	index = _sqLocalTail & *_sqMask;
+	struct io_uring_sqe	*sqe = &_sqes[index];
+	std::memset(sqe, 0, sizeof(*sqe));
+	_sqArray[index] = index;
+	++_sqLocalTail;
+	return (sqe);
+}
+
+/*
+	Submit everything queued and, if min_complete, wait up to timeout_ms for completions.
+	Timing out or being interrupted by a signal is not an error here.
+*/
+int	UringPoller::enter(unsigned int min_complete, int timeout_ms)
+{
+	__atomic_store_n(_sqTail, _sqLocalTail, __ATOMIC_RELEASE);
+	unsigned int	toSubmit = _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+	unsigned int	flags = 0;
+	struct __kernel_timespec	ts;
+	struct io_uring_getevents_arg	arg;
+	void	*argp = NULL;
+	size_t	argsz = 0;
+
+	if (min_complete)
+	{
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeout_ms >= 0)
+		{
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+			std::memset(&arg, 0, sizeof(arg));
+			arg.ts = reinterpret_cast<uintptr_t>(&ts);
+			flags |= IORING_ENTER_EXT_ARG;
+			argp = &arg;
+			argsz = sizeof(arg);
+		}
+	}
+	if (!toSubmit && !flags)
+		return (0);
+	long	res = syscall(__NR_io_uring_enter, _ringfd, toSubmit, min_complete, flags, argp, argsz);
+	if (res < 0 && (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY))
+		return (0);
+	return (static_cast<int>(res));
+}
+
+/*
+	Give the buffers consumed by the previous batch back to the kernel
+*/
+void	UringPoller::recycleBuffers()
+{
+	if (_lent.empty())
+		return;
+	for (size_t i = 0; i < _lent.size(); ++i)
+	{
+		struct io_uring_buf	*buf = &_bufRing[_bufTail & (URING_BUF_COUNT - 1)];
+		buf->addr = reinterpret_cast<uintptr_t>(_bufBase + static_cast<size_t>(_lent[i]) * URING_BUF_SIZE);
+		buf->len = URING_BUF_SIZE;
+		buf->bid = _lent[i];
+		++_bufTail;
+	}
+	__atomic_store_n(&_bufRing[0].resv, _bufTail, __ATOMIC_RELEASE);
+	_lent.clear();
+}
+
+void	UringPoller::track(int fd, Watch watch, short events)
+{
+	if (static_cast<size_t>(fd) >= _watch.size())
+	{
+		_watch.resize(fd + 1, WATCH_NONE);
+		_pollEvents.resize(fd + 1, 0);
+		_gen.resize(fd + 1, 0);
+	}
+	_watch[fd] = watch;
+	_pollEvents[fd] = events;
+}
+
+/*
+	Queue the multishot request matching how fd is watched
+*/
+bool	UringPoller::arm(int fd)
+{
+	struct io_uring_sqe	*sqe = getSqe();
+	if (!sqe)
+		return (false);
+	sqe->fd = fd;
+	switch (_watch[fd])
+	{
+		case WATCH_ACCEPT:
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+			sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+			sqe->user_data = packData(OP_ACCEPT, _gen[fd], fd);
+			break;
+		case WATCH_RECV:
+			sqe->opcode = IORING_OP_RECV;
+			sqe->ioprio = IORING_RECV_MULTISHOT;
+			sqe->flags = IOSQE_BUFFER_SELECT;
+			sqe->buf_group = 0;
+			sqe->user_data = packData(OP_RECV, _gen[fd], fd);
+			break;
+		default:
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->poll32_events = static_cast<unsigned short>(_pollEvents[fd]);
+			sqe->len = IORING_POLL_ADD_MULTI;
+			sqe->user_data = packData(OP_POLL, _gen[fd], fd);
+			break;
+	}
+	return (true);
+}
+
+bool	UringPoller::add(int fd, short events)
+{
+	track(fd, WATCH_POLL, events);
+	if (arm(fd))
+		return (true);
+	_watch[fd] = WATCH_NONE;
+	return (false);
+}
+
+bool	UringPoller::watchListener(int fd)
+{
+	track(fd, WATCH_ACCEPT, POLLIN);
+	if (arm(fd))
+		return (true);
+	_watch[fd] = WATCH_NONE;
+	return (false);
+}
+
+bool	UringPoller::watchClient(int fd)
+{
+	track(fd, WATCH_RECV, POLLIN);
+	if (arm(fd))
+		return (true);
+	_watch[fd] = WATCH_NONE;
+	return (false);
+}
+
+/*
+	Accept and recv are always armed, sends are explicit; only a plain poll watch
+	has an interest set to change.
+*/
+bool	UringPoller::modify(int fd, short events)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _watch.size() || _watch[fd] == WATCH_NONE)
+		return (false);
+	if (_watch[fd] != WATCH_POLL || _pollEvents[fd] == events)
+		return (true);
+	remove(fd);
+	return (add(fd, events));
+}
+
+/*
+	In-flight requests hold a reference to the socket, so the cancel has to reach
+	the kernel now, before the caller closes the fd.
+*/
+void	UringPoller::remove(int fd)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _watch.size() || _watch[fd] == WATCH_NONE)
+		return;
+	_watch[fd] = WATCH_NONE;
+	_gen[fd] = (_gen[fd] + 1) & GEN_MASK;
+	struct io_uring_sqe	*sqe = getSqe();
+	if (!sqe)
+		return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = fd;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = packData(OP_CANCEL, 0, fd);
+	enter(0, -1);
+}
+
+/*
+	Queue the buffers as linked sends so they reach the socket in order.
+	MSG_WAITALL makes a short send fail the chain instead of skipping bytes.
+	Big buffers are cut into pieces whose completions are reported as progress,
+	so a long download keeps its send_timeout fresh.
+*/
+bool	UringPoller::submitSend(int fd, std::vector<std::string> &buffers)
+{
+	if (fd < 0 || static_cast<size_t>(fd) >= _watch.size() || _watch[fd] == WATCH_NONE)
+		return (false);
+	size_t	total = 0;
+	for (size_t i = 0; i < buffers.size(); ++i)
+		total += buffers[i].size();
+	size_t	chunk = URING_SEND_CHUNK;
+	if (total / chunk >= URING_SEND_CHAIN)
+		chunk = total / URING_SEND_CHAIN + 1;
+	unsigned int	count = 0;
+	for (size_t i = 0; i < buffers.size(); ++i)
+		count += static_cast<unsigned int>((buffers[i].size() + chunk - 1) / chunk);
+	if (count == 0 || count > _sqEntries)
+		return (false);
+	// a chain cut across two submissions loses its ordering, so make room first
+	if (_sqEntries - (_sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE)) < count)
+		enter(0, -1);
+	if (_sqEntries - (_sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE)) < count)
+		return (false);
+
+	SendOp	*op = new SendOp();
+	op->fd = fd;
+	op->gen = _gen[fd];
+	op->expected = 0;
+	op->sent = 0;
+	op->pending = count;
+	op->failed = false;
+	op->buffers.resize(buffers.size());
+	for (size_t i = 0; i < buffers.size(); ++i)
+		op->buffers[i].swap(buffers[i]);
+	buffers.clear();
+
+	unsigned int	slot;
+	if (!_freeSends.empty())
+	{
+		slot = _freeSends.back();
+		_freeSends.pop_back();
+		_sends[slot] = op;
+	}
+	else
+	{
+		slot = static_cast<unsigned int>(_sends.size());
+		_sends.push_back(op);
+	}
+
+	unsigned int	queued = 0;
+	for (size_t i = 0; i < op->buffers.size(); ++i)
+	{
+		const std::string	&buf = op->buffers[i];
+		for (size_t off = 0; off < buf.size(); off += chunk)
+		{
+			size_t	len = buf.size() - off < chunk ? buf.size() - off : chunk;
+			struct io_uring_sqe	*sqe = getSqe();
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = fd;
+			sqe->addr = reinterpret_cast<uintptr_t>(buf.data() + off);
+			sqe->len = static_cast<unsigned int>(len);
+			sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+			if (++queued < count)
+				sqe->flags = IOSQE_IO_LINK;
+			sqe->user_data = packData(OP_SEND, 0, slot);
+		}
+	}
+	op->expected = total;
+	return (true);
+}
+
+/*
+	One completion of a send chain; the caller hears about it once the whole chain is done
+*/
+void	UringPoller::completeSend(unsigned int slot, int res, std::vector<PollEvent> &ready)
+{
+	SendOp	*op = _sends[slot];
+	if (res < 0)
+		op->failed = true;
+	else
+		op->sent += static_cast<size_t>(res);
+	--op->pending;
+	bool	current = static_cast<size_t>(op->fd) < _gen.size() && _gen[op->fd] == op->gen
+		&& _watch[op->fd] != WATCH_NONE;
+	if (current && (op->pending == 0 || (res > 0 && !op->failed)))
+	{
+		PollEvent	ev;
+		ev.fd = op->fd;
+		ev.events = POLLOUT;
+		ev.tag = op->gen;
+		if (op->pending > 0)
+		{
+			ev.kind = EVENT_SEND_PROGRESS;
+			ev.result = res;
+		}
+		else
+		{
+			ev.kind = EVENT_SENT;
+			ev.result = (op->failed || op->sent != op->expected) ? -1 : static_cast<long>(op->sent);
+		}
+		ready.push_back(ev);
+	}
+	if (op->pending > 0)
+		return;
+	delete op;
+	_sends[slot] = NULL;
+	_freeSends.push_back(slot);
+}
+
+/*
+	Turn every pending completion into a PollEvent.
+	Completions for a removed fd (older generation) are dropped, but their
+	receive buffer still goes back to the ring.
+*/
+void	UringPoller::reap(std::vector<PollEvent> &ready)
+{
+	unsigned int	head = *_cqHead;
+	unsigned int	tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; ++head)
+	{
+		const struct io_uring_cqe	*cqe = &_cqes[head & *_cqMask];
+		unsigned long long	data = cqe->user_data;
+		unsigned long long	op = data >> 60;
+		int	res = cqe->res;
+		unsigned int	flags = cqe->flags;
+
+		if (op == OP_SEND)
+		{
+			completeSend(static_cast<unsigned int>(data & 0xFFFFFFFFULL), res, ready);
+			continue;
+		}
+		int	fd = static_cast<int>(data & 0xFFFFFFFFULL);
+		unsigned int	gen = static_cast<unsigned int>(data >> 32) & GEN_MASK;
+		bool	current = static_cast<size_t>(fd) < _gen.size() && _gen[fd] == gen && _watch[fd] != WATCH_NONE;
+		bool	more = (flags & IORING_CQE_F_MORE) != 0;
+		const char	*buffer = NULL;
+		if (flags & IORING_CQE_F_BUFFER)
+		{
+			unsigned short	bid = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+			buffer = _bufBase + static_cast<size_t>(bid) * URING_BUF_SIZE;
+			_lent.push_back(bid);
+		}
+		if (op == OP_CANCEL)
+			continue;
+		if (!current)
+		{
+			// accepted after its listener went away: nobody will serve it
+			if (op == OP_ACCEPT && res >= 0)
+				close(res);
+			continue;
+		}
+		if (op == OP_RECV && res == -ENOBUFS)
+		{
+			// every buffer is lent out; they come back (and recv resumes) next wait()
+			_rearm.push_back(std::make_pair(fd, gen));
+			continue;
+		}
+		// the kernel ended the multishot request; keep it going unless the fd is done
+		if (!more && (res > 0 || (op == OP_ACCEPT && res >= 0) || op == OP_POLL))
+			_rearm.push_back(std::make_pair(fd, gen));
+
+		PollEvent	ev;
+		ev.fd = fd;
+		ev.tag = gen;
+		ev.result = res;
+		if (op == OP_ACCEPT)
+		{
+			ev.kind = EVENT_ACCEPTED;
+			ev.events = POLLIN;
+		}
+		else if (op == OP_RECV)
+		{
+			ev.kind = EVENT_RECEIVED;
+			ev.events = POLLIN;
+			ev.data = res > 0 ? buffer : NULL;
+		}
+		else
+		{
+			ev.kind = EVENT_READY;
+			ev.events = res < 0 ? POLLERR : static_cast<short>(res);
+		}
+		ready.push_back(ev);
+	}
+	__atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+}
+
+int	UringPoller::wait(std::vector<PollEvent> &ready, int timeout_ms)
+{
+	ready.clear();
+	// the caller is done with the previous batch's data
+	recycleBuffers();
+	std::vector<std::pair<int, unsigned int> >	rearm;
+	rearm.swap(_rearm);
+	for (size_t i = 0; i < rearm.size(); ++i)
+	{
+		int	fd = rearm[i].first;
+		if (_gen[fd] == rearm[i].second && _watch[fd] != WATCH_NONE)
+			arm(fd);
+	}
+
+	bool	pending = *_cqHead != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+	if (enter(pending ? 0 : 1, timeout_ms) < 0)
+		return (-1);
+	reap(ready);
+	return (static_cast<int>(ready.size()));
+}
+
+const char	*UringPoller::name() const
+{
+	return ("io_uring");
+}
+
+bool	UringPoller::completionBased() const
+{
+	return (true);
+}
+
+bool	UringPoller::isStale(const PollEvent &ev) const
+{
+	if (ev.fd < 0 || static_cast<size_t>(ev.fd) >= _gen.size())
+		return (false);
+	return (_gen[ev.fd] != ev.tag || _watch[ev.fd] == WATCH_NONE);
+}
+
+#endif
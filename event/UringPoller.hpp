@@ -0,0 +1,111 @@
+#ifndef URINGPOLLER_HPP
+# define URINGPOLLER_HPP
+
+#include "EventPoller.hpp"
+
+#ifdef __linux__
+
+# include <linux/io_uring.h>
+# include <utility>
+
+# define URING_SQ_ENTRIES 1024
+# define URING_CQ_ENTRIES 8192
+# define URING_BUF_COUNT 512 // provided receive buffers, power of two
+# define URING_BUF_SIZE 4096
+# define URING_SEND_CHUNK (256 * 1024) // large buffers go out as several linked sends
+# define URING_SEND_CHAIN 64 // past this many pieces the chunks grow instead
+
+/*
+	Completion backend built on raw io_uring syscalls (no liburing).
+	Listeners get one multishot accept, clients one multishot recv that picks its
+	buffer from a ring registered with the kernel, and queued responses go out as
+	linked sends. wait() reports what those operations did instead of readiness.
+	Fds added with plain add() (the reactor wake eventfd) use a multishot poll.
+	Needs Linux 6.0+; isValid() is false otherwise and create() falls back to epoll.
+*/
+class	UringPoller: public EventPoller
+{
+	private:
+		enum Watch { WATCH_NONE, WATCH_POLL, WATCH_ACCEPT, WATCH_RECV };
+
+		// one submitSend: the buffers stay here until every linked send completed
+		struct SendOp
+		{
+			int	fd;
+			unsigned int	gen;
+			std::vector<std::string>	buffers;
+			size_t	expected;
+			size_t	sent;
+			unsigned int	pending; // sends not completed yet
+			bool	failed;
+		};
+
+		int	_ringfd;
+		bool	_valid;
+
+		// submission queue
+		void	*_sqMap;
+		size_t	_sqMapLen;
+		unsigned int	*_sqHead;
+		unsigned int	*_sqTail;
+		unsigned int	*_sqMask;
+		unsigned int	*_sqArray;
+		unsigned int	_sqEntries;
+		struct io_uring_sqe	*_sqes;
+		size_t	_sqesLen;
+		unsigned int	_sqLocalTail; // our tail, published to the kernel by enter()
+
+		// completion queue, inside the same mapping
+		unsigned int	*_cqHead;
+		unsigned int	*_cqTail;
+		unsigned int	*_cqMask;
+		struct io_uring_cqe	*_cqes;
+
+		// provided buffer ring for multishot recv. Addressed as plain entries: in C++ the
+		// header's io_uring_buf_ring puts bufs[] 8 bytes off; the tail is entry 0's resv
+		struct io_uring_buf	*_bufRing;
+		char	*_bufBase;
+		unsigned short	_bufTail;
+		std::vector<unsigned short>	_lent; // handed out by the last wait(), recycled by the next
+
+		// indexed by fd
+		std::vector<unsigned char>	_watch;
+		std::vector<short>	_pollEvents;
+		std::vector<unsigned int>	_gen; // bumped by remove(), older completions are dropped
+		std::vector<std::pair<int, unsigned int> >	_rearm; // (fd, gen) whose multishot ended, armed again next wait()
+
+		std::vector<SendOp *>	_sends; // slot index is the send's user_data
+		std::vector<unsigned int>	_freeSends;
+
+		bool	setup();
+		bool	probe();
+		bool	setupBufferRing();
+		struct io_uring_sqe	*getSqe();
+		int		enter(unsigned int min_complete, int timeout_ms);
+		void	recycleBuffers();
+		bool	arm(int fd);
+		void	track(int fd, Watch watch, short events);
+		void	reap(std::vector<PollEvent> &ready);
+		void	completeSend(unsigned int slot, int res, std::vector<PollEvent> &ready);
+
+	public:
+		UringPoller();
+		~UringPoller();
+
+		bool	isValid() const;
+		bool	add(int fd, short events);
+		bool	modify(int fd, short events);
+		void	remove(int fd);
+		int		wait(std::vector<PollEvent> &ready, int timeout_ms);
+		const char	*name() const;
+
+		bool	completionBased() const;
+		bool	watchListener(int fd);
+		bool	watchClient(int fd);
+		bool	submitSend(int fd, std::vector<std::string> &buffers);
+		bool	isStale(const PollEvent &ev) const;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+#include "BodyInflater.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#ifdef WEBSERV_ZLIB
+# include <zlib.h>
+#endif
+
+static bool	isCoding(const char *value, size_t length, const char *name)
+{
+	size_t	nameLen = std::strlen(name);
+	if (length != nameLen)
+		return (false);
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (std::tolower(static_cast<unsigned char>(value[i])) != name[i])
+			return (false);
+	}
+	return (true);
+}
+
+ContentCoding	parseContentCoding(const char *value, size_t length)
+{
+	if (length == 0 || isCoding(value, length, "identity"))
+		return (CODING_IDENTITY);
+	if (isCoding(value, length, "gzip") || isCoding(value, length, "x-gzip"))
+		return (CODING_GZIP);
+	if (isCoding(value, length, "deflate"))
+		return (CODING_DEFLATE);
+	return (CODING_UNKNOWN);
+}
+
+BodyInflater::BodyInflater(): _stream(NULL), _ended(false)
+{
+}
+
+#ifdef WEBSERV_ZLIB
+
+BodyInflater::~BodyInflater()
+{
+	if (this->_stream)
+	{
+		inflateEnd(static_cast<z_stream *>(this->_stream));
+		delete static_cast<z_stream *>(this->_stream);
+	}
+}
+
+bool	BodyInflater::available()
+{
+	return (true);
+}
+
+bool	BodyInflater::start(ContentCoding coding)
+{
+	if (this->_stream || (coding != CODING_GZIP && coding != CODING_DEFLATE))
+		return (false);
+	z_stream	*stream = new z_stream();
+	// window bits 15, +16 for the gzip wrapper instead of the zlib one (RFC 9110 §8.4.1)
+	if (inflateInit2(stream, coding == CODING_GZIP ? 16 + MAX_WBITS : MAX_WBITS) != Z_OK)
+	{
+		delete stream;
+		return (false);
+	}
+	this->_stream = stream;
+	return (true);
+}
+
+BodyInflater::Status	BodyInflater::run(const char *in, size_t inLength, size_t &used,
+	char *out, size_t outLength, size_t &produced)
+{
+	used = 0;
+	produced = 0;
+	if (!this->_stream)
+		return (INFLATE_ERROR);
+	if (this->_ended)
+		return (inLength > 0 ? INFLATE_ERROR : INFLATE_END);
+	z_stream	*stream = static_cast<z_stream *>(this->_stream);
+	// zlib counts in uInt: a larger input is taken over several calls
+	stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in));
+	stream->avail_in = static_cast<uInt>(std::min<size_t>(inLength, 1u << 30));
+	stream->next_out = reinterpret_cast<Bytef *>(out);
+	stream->avail_out = static_cast<uInt>(outLength);
+	int	status = inflate(stream, Z_NO_FLUSH);
+	used = reinterpret_cast<const char *>(stream->next_in) - in;
+	produced = reinterpret_cast<char *>(stream->next_out) - out;
+	if (status == Z_STREAM_END)
+	{
+		this->_ended = true;
+		return (INFLATE_END);
+	}
+	// Z_BUF_ERROR: no progress was possible, which only means more input is needed
+	if (status == Z_OK || status == Z_BUF_ERROR)
+		return (INFLATE_MORE);
+	return (INFLATE_ERROR);
+}
+
+#else
+
+BodyInflater::~BodyInflater()
+{
+}
+
+bool	BodyInflater::available()
+{
+	return (false);
+}
+
+bool	BodyInflater::start(ContentCoding)
+{
+	return (false);
+}
+
+BodyInflater::Status	BodyInflater::run(const char *, size_t, size_t &used, char *, size_t, size_t &produced)
+{
+	used = 0;
+	produced = 0;
+	return (INFLATE_ERROR);
+}
+
+#endif
+
+bool	BodyInflater::finished() const
+{
+	return (this->_ended);
+}
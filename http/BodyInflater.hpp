@@ -0,0 +1,52 @@
+#ifndef BODYINFLATER_HPP
+# define BODYINFLATER_HPP
+
+#include <cstddef>
+
+# define INFLATE_CHUNK (16 * 1024) // inflated bytes produced per step
+
+// Content-Encoding of a request body, as far as the server can undo it
+enum	ContentCoding
+{
+	CODING_IDENTITY,
+	CODING_GZIP,
+	CODING_DEFLATE,
+	CODING_UNKNOWN // anything else, a list of codings included
+};
+
+ContentCoding	parseContentCoding(const char *value, size_t length);
+
+/*
+	Streaming zlib inflate of a gzip or deflate body. Input is fed as it is framed,
+	output comes back in steps, so a body never needs its compressed and inflated
+	forms in memory at once. Built only with WEBSERV_ZLIB (make ZLIB=1, the default);
+	without it available() is false and encoded bodies are refused with 415.
+*/
+class	BodyInflater
+{
+	private:
+		void	*_stream; // z_stream, NULL until start()
+		bool	_ended;
+
+		BodyInflater(const BodyInflater &other);
+		BodyInflater	&operator=(const BodyInflater &other);
+
+	public:
+		enum Status
+		{
+			INFLATE_MORE,  // call again: with the rest of the input, or the next bytes
+			INFLATE_END,   // end of the compressed stream
+			INFLATE_ERROR  // corrupt data, or bytes after the end
+		};
+
+		BodyInflater();
+		~BodyInflater();
+
+		static bool	available();
+		bool	start(ContentCoding coding);
+		bool	finished() const;
+		// used: input bytes taken, produced: bytes written to out (at most outLength)
+		Status	run(const char *in, size_t inLength, size_t &used, char *out, size_t outLength, size_t &produced);
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "ByteScan.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+# define SCAN_X86 1
+# include <immintrin.h>
+#endif
+
+typedef const char	*(*NeedleKernel)(const char *begin, const char *end, const char *needle, size_t length);
+
+struct	ScanKernels
+{
+	const char		*name;
+	NeedleKernel	needle;
+};
+
+/*************************** SCALAR ***************************/
+
+/*
+	Single bytes always go to memchr: glibc's already picks an SSE2/AVX2/EVEX version
+	at load time, and on lines a few dozen bytes long it beat kernels of our own.
+*/
+static const char	*byteScalar(const char *begin, const char *end, char c)
+{
+	const void	*hit = std::memchr(begin, c, static_cast<size_t>(end - begin));
+	return (hit ? static_cast<const char *>(hit) : end);
+}
+
+// candidates by the first byte, then a compare: what std::string::find does
+static const char	*needleScalar(const char *begin, const char *end, const char *needle, size_t length)
+{
+	const char	*last = end - length + 1; // last start position + 1
+	while (begin < last)
+	{
+		begin = byteScalar(begin, last, needle[0]);
+		if (begin == last)
+			break;
+		if (std::memcmp(begin + 1, needle + 1, length - 1) == 0)
+			return (begin);
+		++begin;
+	}
+	return (end);
+}
+
+#ifdef SCAN_X86
+
+/*************************** SSE2 ***************************/
+
+/*
+	Positions where the needle's first and last bytes both match, 16 at a time;
+	only those get the memcmp of the bytes in between.
+*/
+static const char	*needleSse2(const char *begin, const char *end, const char *needle, size_t length)
+{
+	const __m128i	first = _mm_set1_epi8(needle[0]);
+	const __m128i	last = _mm_set1_epi8(needle[length - 1]);
+	const char		*stop = end - length + 1; // last start position + 1
+	for (; stop - begin >= 16; begin += 16)
+	{
+		__m128i	head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+		__m128i	tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + length - 1));
+		unsigned int	mask = static_cast<unsigned int>(_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+		while (mask)
+		{
+			int	bit = __builtin_ctz(mask);
+			if (std::memcmp(begin + bit + 1, needle + 1, length - 2) == 0)
+				return (begin + bit);
+			mask &= mask - 1;
+		}
+	}
+	return (needleScalar(begin, end, needle, length));
+}
+
+/*************************** AVX2 ***************************/
+
+__attribute__((target("avx2")))
+static const char	*needleAvx2(const char *begin, const char *end, const char *needle, size_t length)
+{
+	const __m256i	first = _mm256_set1_epi8(needle[0]);
+	const __m256i	last = _mm256_set1_epi8(needle[length - 1]);
+	const char		*stop = end - length + 1;
+	for (; stop - begin >= 32; begin += 32)
+	{
+		__m256i	head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+		__m256i	tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin + length - 1));
+		unsigned int	mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+		while (mask)
+		{
+			int	bit = __builtin_ctz(mask);
+			if (std::memcmp(begin + bit + 1, needle + 1, length - 2) == 0)
+				return (begin + bit);
+			mask &= mask - 1;
+		}
+	}
+	return (needleSse2(begin, end, needle, length));
+}
+
+#endif
+
+/*************************** DISPATCH ***************************/
+
+static const ScanKernels	g_backends[] =
+{
+#ifdef SCAN_X86
+	{"avx2", needleAvx2},
+	{"sse2", needleSse2},
+#endif
+	{"scalar", needleScalar}
+};
+static const size_t	g_backendCount = sizeof(g_backends) / sizeof(g_backends[0]);
+
+static bool	cpuSupports(const ScanKernels &kernels)
+{
+#ifdef SCAN_X86
+	if (std::strcmp(kernels.name, "avx2") == 0)
+	{
+		__builtin_cpu_init();
+		return (__builtin_cpu_supports("avx2"));
+	}
+#endif
+	(void)kernels;
+	return (true); // SSE2 is part of x86-64 (and required for SCAN_X86 on i386)
+}
+
+static const ScanKernels	*selectKernels()
+{
+	for (size_t i = 0; i < g_backendCount; ++i)
+	{
+		if (cpuSupports(g_backends[i]))
+			return (&g_backends[i]);
+	}
+	return (&g_backends[g_backendCount - 1]);
+}
+
+// picked during static initialization, before any thread exists
+static const ScanKernels	*g_kernels = selectKernels();
+
+const char	*scanByte(const char *begin, const char *end, char c)
+{
+	return (byteScalar(begin, end, c));
+}
+
+const char	*scanBytes(const char *begin, const char *end, const char *needle, size_t length)
+{
+	if (length == 0)
+		return (begin);
+	if (static_cast<size_t>(end - begin) < length)
+		return (end);
+	if (length == 1)
+		return (byteScalar(begin, end, needle[0]));
+	return (g_kernels->needle(begin, end, needle, length));
+}
+
+size_t	scanFind(const std::string &haystack, char c, size_t from)
+{
+	if (from >= haystack.size())
+		return (std::string::npos);
+	const char	*begin = haystack.data();
+	const char	*end = begin + haystack.size();
+	const char	*hit = scanByte(begin + from, end, c);
+	return (hit == end ? std::string::npos : static_cast<size_t>(hit - begin));
+}
+
+size_t	scanFind(const std::string &haystack, const std::string &needle, size_t from)
+{
+	if (from > haystack.size())
+		return (std::string::npos);
+	const char	*begin = haystack.data();
+	const char	*end = begin + haystack.size();
+	const char	*hit = scanBytes(begin + from, end, needle.data(), needle.size());
+	if (hit == end && !needle.empty())
+		return (std::string::npos);
+	return (static_cast<size_t>(hit - begin));
+}
+
+const char	*scanBackend()
+{
+	return (g_kernels->name);
+}
+
+bool	scanUseBackend(const std::string &name)
+{
+	for (size_t i = 0; i < g_backendCount; ++i)
+	{
+		if (name == g_backends[i].name && cpuSupports(g_backends[i]))
+		{
+			g_kernels = &g_backends[i];
+			return (true);
+		}
+	}
+	return (false);
+}
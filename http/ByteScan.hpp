@@ -0,0 +1,28 @@
+#ifndef BYTESCAN_HPP
+# define BYTESCAN_HPP
+
+#include <string>
+#include <cstddef>
+
+/*
+	Delimiter searches for the request path: a single byte (LF, ':') and a short
+	needle (CRLFCRLF, multipart boundaries).
+	Single bytes go to memchr. The needle search compares 32 (AVX2) or 16 (SSE2)
+	positions per step and only looks closer where the needle's first and last bytes
+	both match, so a boundary scan over an upload body rarely falls back to a memcmp.
+	The kernel set is picked once at startup from what the CPU supports.
+*/
+
+// first c in [begin, end), end if there is none
+const char	*scanByte(const char *begin, const char *end, char c);
+// first occurrence of needle[0, length) in [begin, end), end if there is none
+const char	*scanBytes(const char *begin, const char *end, const char *needle, size_t length);
+
+// std::string::find equivalents, npos if not found
+size_t	scanFind(const std::string &haystack, char c, size_t from = 0);
+size_t	scanFind(const std::string &haystack, const std::string &needle, size_t from = 0);
+
+const char	*scanBackend(); // "avx2", "sse2" or "scalar"
+bool	scanUseBackend(const std::string &name); // for benchmarks; false if the CPU lacks it
+
+#endif
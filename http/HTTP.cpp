@@ -10,104 +10,85 @@
 #include <sstream>
 #include "../Server.hpp"
 
+RouteContext::RouteContext():
+	server(NULL), location(NULL), cgi_executor(NULL), root(NULL),
+	body_limit(0), decode_body(true), resolved(false)
+{
+}
+
+static const std::string	g_defaultRoot("pages/www");
+
+/*
+	Server by local address and Host, location by the server's route trie, and what the
+	location decides for this path. Pointers into the configuration, which outlives it.
+*/
+void	resolveRoute(const HTTPRequest &request, const std::vector<ServerConfig> &servers, RouteContext &route)
+{
+	route = RouteContext();
+	route.resolved = true;
+	route.server = findServerConfig(request, servers);
+	route.root = &g_defaultRoot;
+	if (!route.server)
+		return;
+	route.root = &route.server->root;
+	route.body_limit = route.server->client_max_body_size;
+	route.location = getMatchingLocation(request.getPath(), route.server);
+	const Location	*location = route.location;
+	if (!location)
+		return;
+	if (!location->root.empty())
+		route.root = &location->root;
+	if (location->has_body_size)
+		route.body_limit = location->client_max_body_size;
+	route.decode_body = location->decompress_body;
+	if (!location->cgi_extensions.empty())
+		route.cgi_executor = CGIHelper::findCGIExecutor(request.getPath(), location->cgi_extensions);
+}
+
+// Longest location prefix of path, one walk down the server's trie
 const Location*	getMatchingLocation(const std::string &path, const ServerConfig* servercConfig)
 {
 	if (!servercConfig)
 		return (NULL);
-	const	Location* best = NULL;
-	size_t	best_len = 0;
-
-	// Keep comparing until get a best matched location
-	for (size_t	i = 0; i < servercConfig->locations.size(); ++i)
-	{
-		const Location &current = servercConfig->locations[i];
-		if (path.find(current.path) == 0 && current.path.length() > best_len)
-		{
-			best = &current;
-			best_len = current.path.length();
-		}
-	}
-	return (best);
+	int	index = servercConfig->routes.match(path);
+	if (index < 0)
+		return (NULL);
+	return (&servercConfig->locations[index]);
 }
 
 bool	methodAllowed(const HTTPRequest &request, const Location *Location)
 {
 	// Default "Allow" if not configured
-	if (!Location || Location->allowed_methods.empty())
+	if (!Location || Location->method_mask == 0)
 		return (true);
-	// [ADD] RFC: If GET is allowed, treat HEAD as allowed too.
-	// We check this first so HEAD won’t be rejected when only GET is listed.
-	if (request.getMethod() == "HEAD")
-	{
-		for (size_t i = 0; i < Location->allowed_methods.size(); ++i)
-		{
-			if (Location->allowed_methods[i] == "GET") 
-				return (true);
-		}
-	}
-	for (size_t	i = 0; i < Location->allowed_methods.size(); ++i)
-	{
-		if (request.getMethod() == Location->allowed_methods[i])
-			return (true);
-	}
-	return (false);
+	// HEAD is in the mask wherever GET is (RFC: if GET is allowed, treat HEAD as allowed too)
+	return ((Location->method_mask & METHOD_BIT(request.getMethodId())) != 0);
 }
 
-bool	checkAllowedMethod(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv) // [CHANGE]
+bool	checkAllowedMethod(const HTTPRequest &request, const RouteContext &route, int socketFD, Server& srv) // [CHANGE]
 {
-	const ServerConfig *active = findServerConfig(request, serverConfig);
+	const ServerConfig *active = route.server;
 	if (!active) 
 		return (false);
 
-	std::string	path = request.getPath();
-	const Location *matching_location = getMatchingLocation(path, active);
+	const Location *matching_location = route.location;
 	if (!matching_location)
 		return (false);
 
 	// 405 Method Not Allowed (with Allow:)
 	if (matching_location && !methodAllowed(request, matching_location))
 	{
-		std::ostringstream allow;
-		for (size_t i = 0; i < matching_location->allowed_methods.size(); ++i)
-		{
-			if (i)
-				allow << ", ";
-			allow << matching_location->allowed_methods[i];
-		}
 		// RFC requires Allow header for 405
-		std::string extra = "Allow: " + allow.str() + "\r\n";
+		std::string extra = matching_location->allow_header;
 		extra += request.connectionHeader(request.isConnectionAlive());
 
 		ErrorResponse resp(405, "Method Not Allowed", *active, extra, socketFD);
-		srv.queueResponse(socketFD, resp.getRawResponse()); 
+		srv.queueResponse(socketFD, resp); 
 		return (true);
 	}
 	return (false);
 }
 
-/*
-	413 Payload Too Large (client_max_body_size enforcement)
-*/
-bool	checkPayLoad(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv) // [CHANGE]
-{
-	const ServerConfig *active = findServerConfig(request, serverConfig);
-	if (!active)
-		return (false);
-	if (active->client_max_body_size > 0)
-	{
-		const std::vector<char>&body = request.getBodyVector();
-		if (body.size() > active->client_max_body_size)
-		{
-			// Provide Connection header matching keep-alive decision
-			std::string extra = request.connectionHeader(request.isConnectionAlive());
-			ErrorResponse resp(413, "Payload Too Large", *active, extra, socketFD);
-			srv.queueResponse(socketFD, resp.getRawResponse());
-			return (true);
-		}
-	}
-	return (false);
-}
-
 const char* reasonPhrase(int code)
 {
 	switch (code)
@@ -122,6 +103,24 @@ const char* reasonPhrase(int code)
 			return ("Temporary Redirect");
 		case 308:
 			return ("Permanent Redirect");
+		case 400:
+			return ("Bad Request");
+		case 411:
+			return ("Length Required");
+		case 413:
+			return ("Payload Too Large");
+		case 414:
+			return ("URI Too Long");
+		case 415:
+			return ("Unsupported Media Type");
+		case 431:
+			return ("Request Header Fields Too Large");
+		case 500:
+			return ("Internal Server Error");
+		case 501:
+			return ("Not Implemented");
+		case 505:
+			return ("HTTP Version Not Supported");
 		default:
 			return ("Redirect");
 	}
@@ -149,13 +148,11 @@ const char* reasonPhrase(int code)
 	Connection: close
 
 */
-bool	checkRedirectResponse(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv) // [CHANGE]
+bool	checkRedirectResponse(const HTTPRequest &request, const RouteContext &route, int socketFD, Server& srv) // [CHANGE]
 {
-	const ServerConfig* active = findServerConfig(request, serverConfig);
-	if (!active)
+	if (!route.server)
 		return (false);
-	std::string	path = request.getPath();
-	const Location* matching_location = getMatchingLocation(path, active);
+	const Location* matching_location = route.location;
 	if (!matching_location)
 		return (false);
 
@@ -165,7 +162,7 @@ bool	checkRedirectResponse(const HTTPRequest &request, int socketFD, const std::
 		const std::string &url = matching_location->redirect_url;
 		const char *reason = reasonPhrase(code);
 		bool include_body = true;
-		if (request.getMethod() == "HEAD")
+		if (request.getMethodId() == METHOD_HEAD)
 			include_body = false;
 		std::string body;
 		if (include_body)
@@ -186,33 +183,22 @@ bool	checkRedirectResponse(const HTTPRequest &request, int socketFD, const std::
 			out << body;
 
 		HTTPResponse resp(reason, code, out.str(), socketFD);
-		srv.queueResponse(socketFD, resp.getRawResponse()); 
+		srv.queueResponse(socketFD, resp); 
 		return (true);
 	}
 	return (false);
 }
 
 /*
-	Advance to next pipelined request (if any) by:
-	1) cutting off the bytes we just consumed
-	2) resetting parser state
-	3) re-feeding the leftover tail
-	Returns true if another buffered request is now ready to be processed.
+	Advance to next pipelined request (if any): the parser starts over at its cursor
+	and parses whatever is already buffered in place, and its route is resolved anew.
+	Returns true if bytes of another request are buffered (it may be complete already).
 */
-bool	advancePipeline(HTTPRequest& request)
+bool	advancePipeline(HTTPRequest& request, RouteContext &route)
 {
-	const size_t used = request.endOfMessageOffset();
-	const std::string tail = request.getRawString().substr(used);
+	route.resolved = false;
 	request.resetForNextRequest();
-	if (!tail.empty())
-	{
-		// feed the remainder (may contain another full request)
-		// NOTE: feed takes std::string& in your class, so create a modifiable copy.
-		std::string copy = tail;
-		request.feed(copy);
-		return (true);
-	}
-	return (false);
+	return (request.hasPendingData());
 }
 
 void	printRequest(const HTTPRequest &request)
@@ -223,128 +209,213 @@ void	printRequest(const HTTPRequest &request)
 	std::cout << "Version: " << request.getVersion() << std::endl;
 
 	std::cout << GREEN << "\n--- Headers ---\n" << RESET;
-	const std::map<std::string, std::string>& headers = request.getHeaderMap();
-	for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it)
-		std::cout << it->first << ": " << it->second << std::endl;
+	request.printHeaders(std::cout);
 
 	std::cout << GREEN << "\n--- Body ---\n" << RESET;
-	std::cout << request.getRawBody() << std::endl;
+	if (request.getBodyFile() >= 0)
+		std::cout << "(" << request.getBodySize() << " bytes in a temp file)";
+	else
+		std::cout.write(request.getBodyData(), static_cast<std::streamsize>(request.getBodySize()));
+	std::cout << std::endl;
 }
 
-void	readClientData(int socketFD, std::map<int, HTTPRequest>& requestMap, std::vector<struct pollfd>& fds, size_t &i, const std::vector<ServerConfig>& servers, Server& srv) // [CHANGE]
+/*
+	Read until the socket looks drained (a read shorter than asked for) or read_budget bytes
+	came in this tick, instead of one recv per poll round-trip.
+	The recv size adapts per connection: it doubles while reads fill it (a body streaming in),
+	up to max_read_size, and halves again once reads come back small (header traffic).
+	errno is not inspected: -1 on the first read closes as before, later it just ends the loop.
+*/
+void	readClientData(int socketFD, const std::vector<ServerConfig>& servers, Server& srv) // [CHANGE]
 {
-	char	buffer[READ_BYTES] = {0};
-	ssize_t	read_bytes = recv(socketFD, buffer, READ_BYTES, 0);
+	Server::Connection	*conn = srv.findConnection(socketFD);
+	if (!conn)
+		return ;
+	const size_t	max_size = srv.read_buf_.size();
+	size_t	total = 0;
+	while (true)
+	{
+		size_t	want = std::min(conn->read_size, max_size);
+		ssize_t	read_bytes = recv(socketFD, &srv.read_buf_[0], want, 0);
+		if (read_bytes < 0 && total > 0)
+			return ; // nothing more for now
+		if (read_bytes <= 0)
+		{
+			receiveClientData(socketFD, &srv.read_buf_[0], read_bytes, servers, srv); // closes
+			return ;
+		}
+		if (static_cast<size_t>(read_bytes) == want && want < max_size)
+			conn->read_size = std::min(want * 2, max_size);
+		else if (static_cast<size_t>(read_bytes) < want / 4 && want > READ_BYTES)
+			conn->read_size = std::max(want / 2, static_cast<size_t>(READ_BYTES));
+		total += read_bytes;
+		receiveClientData(socketFD, &srv.read_buf_[0], read_bytes, servers, srv);
+		// the request may have closed the connection or decided to close it
+		conn = srv.findConnection(socketFD);
+		if (!conn || conn->close_after_write)
+			return ;
+		if (static_cast<size_t>(read_bytes) < want || total >= srv.global_.read_budget)
+			return ; // level-triggered: whatever is left wakes us next tick
+	}
+}
 
-	if (read_bytes <= 0)
+/*
+	Feed bytes that arrived on a client socket to its parser.
+	len <= 0 means the peer closed or the read failed.
+	readClientData reads them itself; the io_uring backend hands over its recv buffer.
+*/
+void	receiveClientData(int socketFD, const char *data, ssize_t len, const std::vector<ServerConfig>& servers, Server& srv)
+{
+	Server::Connection	*conn = srv.findConnection(socketFD);
+	if (!conn)
+		return ;
+	if (conn->lingering)
+	{
+		srv.discardLingering(socketFD, len); // answered and closing: only the size counts
+		return ;
+	}
+	if (len <= 0)
 	{
 		// Remove client socket from poll set and the map
-		close(socketFD);
-		requestMap.erase(socketFD);
-		srv.client_state_.erase(socketFD);
-		srv.last_activity.erase(socketFD);
-		fds.erase(fds.begin() + i);
-		--i; // Decrement to not skip element after erase
+		srv.closeConnection(socketFD);
 		return ;
 	}
-	if (read_bytes > 0)
-		srv.last_activity[socketFD] = time(NULL);
-	std::string	data(buffer, read_bytes);
 	bool	isClearing = false;
-	isClearing = processClientData(socketFD, requestMap, data, servers, srv); // [CHANGE]
+	isClearing = processClientData(socketFD, conn->request, conn->route, data, static_cast<size_t>(len), servers, srv); // [CHANGE]
 	if (isClearing == true)
 	{
 		// Remove client socket from poll set and the map
-		close(socketFD);
-		requestMap.erase(socketFD);
-		srv.client_state_.erase(socketFD);
-		srv.last_activity.erase(socketFD);
-		fds.erase(fds.begin() + i);
-		--i; // Decrement to not skip element after erase
+		srv.closeConnection(socketFD);
+		return ;
+	}
+	// header, body or send deadline depending on what this read led to
+	srv.refreshTimer(socketFD, true);
+}
+
+/*
+	Answer a request we could not parse with status and close once it is sent
+*/
+static void	rejectRequest(const HTTPRequest &req, int socketFD, int status, const std::vector<ServerConfig>& servers, Server& srv)
+{
+	// Try to derive the right server config from what we know about this fd
+	// (local address, and the Host header if it was parsed already)
+	const ServerConfig* active = findServerConfig(req, servers);
+
+	// Fallback: if nothing resolved, use the first configured server
+	if (!active && !servers.empty())
+		active = &servers[0];
+
+	if (active)
+	{
+		ErrorResponse err(status, reasonPhrase(status), *active, socketFD);
+		srv.queueResponse(socketFD, err);
+		srv.markCloseAfterWrite(socketFD);
+	}
+	else
+	{
+		// Last-resort literal response (no config available)
+		std::string reason = reasonPhrase(status);
+		std::ostringstream body;
+		body << "<!DOCTYPE html><html><head><meta charset=\"utf-8\"/>"
+			<< "<title>" << status << " " << reason << "</title></head><body>"
+			<< "<h1>" << status << " " << reason << "</h1></body></html>";
+		std::ostringstream out;
+		out << "Content-Type: text/html\r\n"
+			<< "Connection: close\r\n\r\n"
+			<< body.str();
+		HTTPResponse err(reason, status, out.str(), socketFD);
+		srv.queueResponse(socketFD, err);
+		srv.markCloseAfterWrite(socketFD);
 	}
-	
+}
+
+/*
+	Expect: 100-continue, the client holds the body back until we answer.
+	A request that is refused anyway (method, redirect) gets its final status now and
+	the connection closes once it is sent, so the body is never transferred; otherwise
+	an interim 100 Continue asks for it. The size check already ran in setBodyLimit().
+	Returns true when the final response was queued.
+*/
+static bool	answerExpectation(HTTPRequest &req, const RouteContext &route, int socketFD, Server& srv)
+{
+	bool	alive = req.isConnectionAlive();
+	req.setConnectionAlive(false); // for the Connection header of a refusal
+	if (checkAllowedMethod(req, route, socketFD, srv) || checkRedirectResponse(req, route, socketFD, srv))
+	{
+		srv.markCloseAfterWrite(socketFD);
+		req.abandon();
+		return (true);
+	}
+	req.setConnectionAlive(alive);
+	// an HTTP/1.0 client does not know interim responses (RFC 9110 §15.2)
+	if (req.getVersion() == "HTTP/1.1")
+		srv.queueResponse(socketFD, std::string("HTTP/1.1 100 Continue\r\n\r\n"));
+	return (false);
 }
 
 /*
 	HTTP/1.1 pipelining	
 	client sends multiple requests back-to-back on the same TCP connection without waiting for the previous response	
 */
-bool	processClientData(int socketFD, std::map<int, HTTPRequest>& requestMap, std::string data, const std::vector<ServerConfig>& servers, Server& srv) // [CHANGE]
+bool	processClientData(int socketFD, HTTPRequest& req, RouteContext &route, const char *data, size_t len, const std::vector<ServerConfig>& servers, Server& srv) // [CHANGE]
 {
+	// already answered with an error, the connection closes once that is sent
+	if (req.hasError())
+		return (false);
 	try
 	{
-		HTTPRequest& req = requestMap[socketFD];
-		req.feed(data);
+		req.feed(data, len);
 
 		// Process as many pipelined requests as are fully buffered
-		while (req.isHeaderComplete() && req.isBodyComplete())
+		while (true)
 		{
+			// headers are in: the body is only read once it is known to fit
+			if (req.awaitingBodyLimit())
+			{
+				resolveRoute(req, servers, route);
+				req.setBodyLimit(route.body_limit, route.decode_body);
+				if (!req.hasError() && !req.isBodyComplete() && req.headerContains(HDR_EXPECT, "100-continue")
+					&& answerExpectation(req, route, socketFD, srv))
+					return (false);
+			}
+			if (!req.isBodyComplete())
+				break;
+			if (!route.resolved) // no body: complete as soon as the headers were
+				resolveRoute(req, servers, route);
 			std::cout << "Request From Socket " << socketFD << " had successfully converted into object!\n";
 			printRequest(req);
 
-			if (checkAllowedMethod(req, socketFD, servers, srv) ||
-				checkPayLoad(req, socketFD, servers, srv) ||
-				checkRedirectResponse(req, socketFD, servers, srv))
+			if (checkAllowedMethod(req, route, socketFD, srv) ||
+				checkRedirectResponse(req, route, socketFD, srv))
 			{
 				bool closeIt = !req.isConnectionAlive();
 				if (closeIt)
 					srv.markCloseAfterWrite(socketFD);  // close after queued bytes flush
 
-				if (advancePipeline(req))
+				if (advancePipeline(req, route))
 					continue; // loop for next buffered request
 				return (false); // no more pipelined data
 			}
 			// normal response path
-			handleRequestProcessing(req, socketFD, servers, srv); // [CHANGE] queues internally
+			handleRequestProcessing(req, route, socketFD, srv); // [CHANGE] queues internally
 			bool closeIt = !req.isConnectionAlive();
 			if (closeIt)
 				srv.markCloseAfterWrite(socketFD);  // close after queued bytes flush
 
-			if (advancePipeline(req))
+			if (advancePipeline(req, route))
 				continue; // loop for next buffered request
 			return (false); // no more pipelined data
 		}
+		// malformed or over a limit: the parser stopped with the status to answer
+		if (req.hasError())
+			rejectRequest(req, socketFD, req.getErrorStatus(), servers, srv);
 		return (false); // need more bytes for next request
 	}
 	catch (const std::exception &e)
 	{
 		std::cerr << "Error while processing client data from socket "
 				<< socketFD << ": " << e.what() << "\n";
-
-		// Try to derive the right server config from what we know about this fd
-		const ServerConfig* active = NULL;
-
-		// If we still have a request object for this fd, try to use its Host header
-		std::map<int, HTTPRequest>::const_iterator it = requestMap.find(socketFD);
-		if (it != requestMap.end())
-			active = findServerConfig(it->second, servers);
-
-		// Fallback: if nothing resolved, use the first configured server
-		if (!active && !servers.empty())
-			active = &servers[0];
-
-		if (active)
-		{
-			ErrorResponse err(400, "Bad Request", *active, socketFD);
-			srv.queueResponse(socketFD, err.getRawResponse());
-			srv.markCloseAfterWrite(socketFD);
-		}
-		else
-		{
-			// Last-resort literal response (no config available)
-			const std::string body =
-				"<!DOCTYPE html><html><head><meta charset=\"utf-8\"/>"
-				"<title>400 Bad Request</title></head><body>"
-				"<h1>400 Bad Request</h1></body></html>";
-			std::ostringstream out;
-			out << "Content-Type: text/html\r\n"
-				<< "Connection: close\r\n\r\n"
-				<< body;
-			HTTPResponse err("Bad Request", 400, out.str(), socketFD);
-			srv.queueResponse(socketFD, err.getRawResponse());
-			srv.markCloseAfterWrite(socketFD);
-		}
-
+		rejectRequest(req, socketFD, 400, servers, srv);
 		return (false); // let POLLOUT flush then close
 	}
 }
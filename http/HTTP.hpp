@@ -19,22 +19,42 @@
 # include "../config_files/config.hpp"
 # include <map>
 # include <string>
+# include <sys/types.h>
 
 class Server;
 
+/*
+	Where a request goes, resolved once when its headers are in and read by every later
+	stage (body limit, Expect, method, redirect, CGI or static) instead of each of them
+	selecting the server and scanning the locations again
+*/
+struct RouteContext
+{
+	const ServerConfig	*server;     // NULL: no server listens where the request came in
+	const Location		*location;   // NULL: no location matches the path
+	const std::string	*cgi_executor; // interpreter for the path's extension, NULL: not CGI
+	const std::string	*root;       // static files: the location's root, else the server's
+	size_t	body_limit;              // client_max_body_size in effect, 0 = unlimited
+	bool	decode_body;             // decompress_request_body in effect
+	bool	resolved;
+
+	RouteContext();
+};
+
+void	resolveRoute(const HTTPRequest &request, const std::vector<ServerConfig> &servers, RouteContext &route);
 const	Location* getMatchingLocation(const std::string &path, const ServerConfig* servercConfig);
 bool	methodAllowed(const HTTPRequest &request, const Location *Location);
-bool	checkAllowedMethod(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv); // [CHANGE]
-bool	checkPayLoad(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv);       // [CHANGE]
+bool	checkAllowedMethod(const HTTPRequest &request, const RouteContext &route, int socketFD, Server& srv); // [CHANGE]
 const char* reasonPhrase(int code);
-bool	checkRedirectResponse(const HTTPRequest &request, int socketFD, const std::vector<ServerConfig> &serverConfig, Server& srv); // [CHANGE]
+bool	checkRedirectResponse(const HTTPRequest &request, const RouteContext &route, int socketFD, Server& srv); // [CHANGE]
 
 // Utility
-bool	advancePipeline(HTTPRequest& request);
+bool	advancePipeline(HTTPRequest& request, RouteContext &route);
 
 // std::string	generateResponseBody(); // for hardcoded body
-void	readClientData(int socketFD, std::map<int, HTTPRequest>& requestMap, std::vector<struct pollfd>& fds, size_t &i, const std::vector<ServerConfig>& servers, Server& srv); // [CHANGE]
-bool	processClientData(int socketFD, std::map<int, HTTPRequest>& requestMap, std::string data, const std::vector<ServerConfig>& servers, Server& srv); // [CHANGE]
+void	readClientData(int socketFD, const std::vector<ServerConfig>& servers, Server& srv); // [CHANGE]
+void	receiveClientData(int socketFD, const char *data, ssize_t len, const std::vector<ServerConfig>& servers, Server& srv);
+bool	processClientData(int socketFD, HTTPRequest& req, RouteContext &route, const char *data, size_t len, const std::vector<ServerConfig>& servers, Server& srv); // [CHANGE]
 
 
 // Debug Message
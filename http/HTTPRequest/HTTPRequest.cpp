@@ -1,66 +1,273 @@
 #include "HTTPRequest.hpp"
+#include "../ByteScan.hpp"
+#include "../UriPath.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/*
+	Perfect hash of the known header names: slot = (length + lowercased first letter) & 31.
+	The table is laid out for exactly these names and each one has a slot of its own,
+	so a lookup is one hash and at most one compare. It was derived by computing that
+	sum for every name and checking that no two land in the same slot (the comment on
+	each entry is its slot). A new name needs a free slot (or a new hash) before it
+	goes in; checkKnownHeaders() below stops the server at startup if the table and
+	the hash disagree.
+*/
+struct	KnownHeader
+{
+	const char	*name;
+	size_t		length;
+	HeaderId	id;
+};
+
+static const KnownHeader	g_knownHeaders[32] =
+{
+	{NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER},
+	{NULL, 0, HDR_OTHER},
+	{"transfer-encoding", 17, HDR_TRANSFER_ENCODING},  // 5
+	{NULL, 0, HDR_OTHER},
+	{"accept", 6, HDR_ACCEPT},                         // 7
+	{NULL, 0, HDR_OTHER},
+	{"cookie", 6, HDR_COOKIE},                         // 9
+	{NULL, 0, HDR_OTHER},
+	{"expect", 6, HDR_EXPECT},                         // 11
+	{"host", 4, HDR_HOST},                             // 12
+	{"connection", 10, HDR_CONNECTION},                // 13
+	{"authorization", 13, HDR_AUTHORIZATION},          // 14
+	{"content-type", 12, HDR_CONTENT_TYPE},            // 15
+	{"accept-encoding", 15, HDR_ACCEPT_ENCODING},      // 16
+	{"content-length", 14, HDR_CONTENT_LENGTH},        // 17
+	{NULL, 0, HDR_OTHER},
+	{"content-encoding", 16, HDR_CONTENT_ENCODING},    // 19
+	{NULL, 0, HDR_OTHER},
+	{"origin", 6, HDR_ORIGIN},                         // 21
+	{NULL, 0, HDR_OTHER},
+	{"range", 5, HDR_RANGE},                           // 23
+	{NULL, 0, HDR_OTHER},
+	{"referer", 7, HDR_REFERER},                       // 25
+	{"if-modified-since", 17, HDR_IF_MODIFIED_SINCE},  // 26
+	{NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER}, {NULL, 0, HDR_OTHER},
+	{"user-agent", 10, HDR_USER_AGENT}                 // 31
+};
+
+static size_t	knownHeaderSlot(const char *name, size_t length)
+{
+	return ((length + (static_cast<unsigned char>(name[0]) | 0x20)) & 31);
+}
+
+static bool	equalsNoCase(const char *a, const char *b, size_t length)
+{
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+			return (false);
+	}
+	return (true);
+}
+
+HeaderId	lookupHeader(const char *name, size_t length)
+{
+	if (length == 0)
+		return (HDR_OTHER);
+	const KnownHeader	&known = g_knownHeaders[knownHeaderSlot(name, length)];
+	if (known.length == length && equalsNoCase(name, known.name, length))
+		return (known.id);
+	return (HDR_OTHER);
+}
+
+/*
+	Every name sits in the slot its hash picks, every HeaderId is in the table exactly
+	once, and each name round-trips through lookupHeader in upper and lower case.
+	Run once during static initialization, before any request is parsed.
+*/
+static bool	checkKnownHeaders()
+{
+	size_t	seen[HDR_KNOWN] = {0};
+	for (size_t i = 0; i < 32; ++i)
+	{
+		const KnownHeader	&known = g_knownHeaders[i];
+		if (!known.name)
+			continue;
+		if (known.length != std::strlen(known.name) || known.id >= HDR_KNOWN
+			|| knownHeaderSlot(known.name, known.length) != i)
+			return (false);
+		++seen[known.id];
+		std::string	upper(known.name);
+		for (size_t j = 0; j < upper.size(); ++j)
+			upper[j] = static_cast<char>(std::toupper(static_cast<unsigned char>(upper[j])));
+		if (lookupHeader(known.name, known.length) != known.id
+			|| lookupHeader(upper.c_str(), upper.size()) != known.id)
+			return (false);
+	}
+	for (size_t id = 0; id < HDR_KNOWN; ++id)
+	{
+		if (seen[id] != 1)
+			return (false);
+	}
+	return (true);
+}
+
+static bool	assertKnownHeaders()
+{
+	if (checkKnownHeaders())
+		return (true);
+	std::cerr << "Fatal: the known header table does not match its hash" << std::endl;
+	std::abort();
+}
+
+static const bool	g_knownHeadersChecked = assertKnownHeaders();
+
+static const char	*knownHeaderName(size_t id)
+{
+	for (size_t i = 0; i < 32; ++i)
+	{
+		if (g_knownHeaders[i].name && static_cast<size_t>(g_knownHeaders[i].id) == id)
+			return (g_knownHeaders[i].name);
+	}
+	return ("");
+}
 
 HTTPRequest::HTTPRequest():
-	_headerComplete(false),
-	_bodyComplete(false),
+	_localPort(0),
 	_connectionAlive(true),
+	_state(PARSE_REQUEST_LINE),
+	_requestStart(0),
+	_scan(0),
+	_searchFrom(0),
+	_headerStart(0),
+	_headerEnd(0),
+	_errorStatus(0),
+	_lineMax(REQUEST_LINE_MAX),
+	_headerMax(HEADER_BLOCK_MAX),
+	_headerCountMax(HEADER_COUNT_MAX),
+	_headerCount(0),
+	_bodyMax(0),
+	_bodyBufferMax(BODY_BUFFER_MAX),
+	_tempPath(BODY_TEMP_PATH),
+	_bodyStart(0),
+	_bodyLength(0),
+	_received(0),
+	_bodyFile(NULL),
+	_decoder(NULL),
+	_bodyDecoded(false),
 	_isChunked(false),
-	_chunkedComplete(false),
-	_bodyPos(0),
 	_chunkSize(0),
+	_trailerSize(0),
 	_content_length(0),
-	_request_line_len(0),
+	_methodId(METHOD_UNKNOWN),
 	_useMultipartBoundary(false)
-{}
+{
+	this->clearHeaders();
+}
 
 HTTPRequest::HTTPRequest(int socketFD):
 	_socketFD(socketFD),
-	_headerComplete(false),
-	_bodyComplete(false),
+	_localPort(0),
 	_connectionAlive(true),
+	_state(PARSE_REQUEST_LINE),
+	_requestStart(0),
+	_scan(0),
+	_searchFrom(0),
+	_headerStart(0),
+	_headerEnd(0),
+	_errorStatus(0),
+	_lineMax(REQUEST_LINE_MAX),
+	_headerMax(HEADER_BLOCK_MAX),
+	_headerCountMax(HEADER_COUNT_MAX),
+	_headerCount(0),
+	_bodyMax(0),
+	_bodyBufferMax(BODY_BUFFER_MAX),
+	_tempPath(BODY_TEMP_PATH),
+	_bodyStart(0),
+	_bodyLength(0),
+	_received(0),
+	_bodyFile(NULL),
+	_decoder(NULL),
+	_bodyDecoded(false),
 	_isChunked(false),
-	_chunkedComplete(false),
-	_bodyPos(0),
 	_chunkSize(0),
+	_trailerSize(0),
 	_content_length(0),
-	_request_line_len(0),
+	_methodId(METHOD_UNKNOWN),
 	_useMultipartBoundary(false)
-{}
+{
+	this->clearHeaders();
+}
 
 HTTPRequest::HTTPRequest(const HTTPRequest &other):
-	_socketFD(other._socketFD), _rawString(other._rawString), _rawHeader(other._rawHeader),
-	_rawBody(other._rawBody), _headerComplete(other._headerComplete),
-	_bodyComplete(other._bodyComplete), _connectionAlive(other._connectionAlive),_header(other._header),
-	_body(other._body), _isChunked(other._isChunked),
-	_chunkedComplete(other._chunkedComplete), _bodyPos(other._bodyPos),
-	_chunkSize(other._chunkSize), _content_length(other._content_length),
-	_request_line(other._request_line), _request_line_len(other._request_line_len),
-	_method(other._method), _path(other._path), _version(other._version),
+	_socketFD(other._socketFD), _localAddress(other._localAddress), _localPort(other._localPort),
+	_rawString(other._rawString), _connectionAlive(other._connectionAlive),
+	_state(other._state), _requestStart(other._requestStart), _scan(other._scan), _searchFrom(other._searchFrom),
+	_headerStart(other._headerStart), _headerEnd(other._headerEnd), _errorStatus(other._errorStatus),
+	_lineMax(other._lineMax), _headerMax(other._headerMax), _headerCountMax(other._headerCountMax),
+	_headerCount(other._headerCount), _bodyMax(other._bodyMax), _bodyBufferMax(other._bodyBufferMax),
+	_tempPath(other._tempPath),
+	_other(other._other), _bodyStart(other._bodyStart), _bodyLength(other._bodyLength), _received(other._received),
+	_bodyFile(other._bodyFile), _decoder(other._decoder), _bodyDecoded(other._bodyDecoded), _isChunked(other._isChunked), _chunkSize(other._chunkSize),
+	_trailerSize(other._trailerSize), _content_length(other._content_length), _request_line(other._request_line),
+	_method(other._method), _methodId(other._methodId), _path(other._path), _query(other._query), _version(other._version),
 	_useMultipartBoundary(other._useMultipartBoundary), _boundary(other._boundary)
-{}
+{
+	std::copy(other._known, other._known + HDR_KNOWN, this->_known);
+	if (this->_bodyFile)
+		++this->_bodyFile->refs;
+	if (this->_decoder)
+		++this->_decoder->refs;
+}
 
 HTTPRequest &HTTPRequest::operator=(const HTTPRequest &other)
 {
 	if (this != &other)
 	{
 		this->_socketFD = other._socketFD;
-		this->_rawString = other._rawString;
-		this->_rawHeader = other._rawHeader;
-		this->_rawBody = other._rawBody;
-		this->_header = other._header;
-		this->_body = other._body;
-		this->_headerComplete = other._headerComplete;
-		this->_bodyComplete = other._bodyComplete;
+		this->_localAddress = other._localAddress;
+		this->_localPort = other._localPort;
+		// a copy sized to the source: assigning an idle request frees a large buffer
+		std::string(other._rawString).swap(this->_rawString);
+		std::copy(other._known, other._known + HDR_KNOWN, this->_known);
+		this->_other = other._other;
+		this->_bodyStart = other._bodyStart;
+		this->_bodyLength = other._bodyLength;
+		if (other._bodyFile)
+			++other._bodyFile->refs; // first: other may share our file
+		this->releaseBodyFile();
+		this->_bodyFile = other._bodyFile;
+		if (other._decoder)
+			++other._decoder->refs;
+		this->releaseDecoder();
+		this->_decoder = other._decoder;
+		this->_received = other._received;
+		this->_bodyDecoded = other._bodyDecoded;
 		this->_connectionAlive = other._connectionAlive;
+		this->_state = other._state;
+		this->_requestStart = other._requestStart;
+		this->_scan = other._scan;
+		this->_searchFrom = other._searchFrom;
+		this->_headerStart = other._headerStart;
+		this->_headerEnd = other._headerEnd;
+		this->_errorStatus = other._errorStatus;
+		this->_lineMax = other._lineMax;
+		this->_headerMax = other._headerMax;
+		this->_headerCountMax = other._headerCountMax;
+		this->_headerCount = other._headerCount;
+		this->_bodyMax = other._bodyMax;
+		this->_bodyBufferMax = other._bodyBufferMax;
+		this->_tempPath = other._tempPath;
 		this->_isChunked = other._isChunked;
-		this->_chunkedComplete = other._chunkedComplete;
-		this->_bodyPos = other._bodyPos;
 		this->_chunkSize = other._chunkSize;
+		this->_trailerSize = other._trailerSize;
 		this->_content_length = other._content_length;
 		this->_request_line = other._request_line;
-		this->_request_line_len = other._request_line_len;
 		this->_method = other._method;
+		this->_methodId = other._methodId;
 		this->_path = other._path;
+		this->_query = other._query;
 		this->_version = other._version;
 		this->_useMultipartBoundary = other._useMultipartBoundary;
 		this->_boundary = other._boundary;
@@ -68,7 +275,11 @@ HTTPRequest &HTTPRequest::operator=(const HTTPRequest &other)
 	return (*this);
 }
 
-HTTPRequest::~HTTPRequest() {}
+HTTPRequest::~HTTPRequest()
+{
+	this->releaseBodyFile();
+	this->releaseDecoder();
+}
 
 /************************GETTER & SETTER************************************ */
 /* Getters */
@@ -77,34 +288,120 @@ const std::string	&HTTPRequest::getRawString() const
 	return (this->_rawString);
 }
 
-const std::string &HTTPRequest::getRawHeader() const
+/*
+	The header block as received, without the request line and the final empty line
+*/
+std::string HTTPRequest::getRawHeader() const
+{
+	if (!this->isHeaderComplete())
+		return ("");
+	return (this->sliceString(this->_headerStart, this->_headerEnd - this->_headerStart));
+}
+
+const char *HTTPRequest::getBodyData() const
+{
+	if (this->_bodyFile)
+		return (this->_bodyFile->map ? this->_bodyFile->map : "");
+	return (this->_rawString.data() + this->_bodyStart);
+}
+
+size_t HTTPRequest::getBodySize() const
+{
+	return (this->_bodyLength);
+}
+
+int HTTPRequest::getBodyFile() const
+{
+	return (this->_bodyFile ? this->_bodyFile->fd : -1);
+}
+
+bool HTTPRequest::isBodyDecoded() const
+{
+	return (this->_bodyDecoded);
+}
+
+bool HTTPRequest::hasHeader(HeaderId id) const
 {
-	return (this->_rawHeader);
+	return (id < HDR_KNOWN && this->_known[id].nameLen > 0);
 }
 
-const std::string &HTTPRequest::getRawBody() const
+std::string HTTPRequest::getHeader(HeaderId id) const
 {
-	return (this->_rawBody);
+	if (!this->hasHeader(id))
+		return ("");
+	return (this->sliceString(this->_known[id].value, this->_known[id].valueLen));
 }
 
-const std::map<std::string, std::string> &HTTPRequest::getHeaderMap() const
+std::string HTTPRequest::getHeader(const std::string &name) const
 {
-	return (this->_header);
+	const HeaderField	*field = this->findHeader(name);
+	if (field == NULL)
+		return ("");
+	return (this->sliceString(field->value, field->valueLen));
 }
 
-const std::vector<char> &HTTPRequest::getBodyVector() const
+bool HTTPRequest::headerContains(HeaderId id, const char *token) const
 {
-	return (this->_body);
+	return (id < HDR_KNOWN && this->sliceContains(this->_known[id], token));
+}
+
+/*
+	Every header with its name lowercased, for code that walks all of them (CGI environment)
+*/
+std::map<std::string, std::string> HTTPRequest::getHeaderMap() const
+{
+	std::map<std::string, std::string>	headers;
+	for (size_t id = 0; id < HDR_KNOWN; ++id)
+	{
+		if (this->_known[id].nameLen > 0)
+			headers[knownHeaderName(id)] = this->sliceString(this->_known[id].value, this->_known[id].valueLen);
+	}
+	for (size_t i = 0; i < this->_other.size(); ++i)
+	{
+		std::string	name = this->sliceString(this->_other[i].name, this->_other[i].nameLen);
+		for (size_t j = 0; j < name.size(); ++j)
+			name[j] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[j])));
+		headers[name] = this->sliceString(this->_other[i].value, this->_other[i].valueLen);
+	}
+	return (headers);
+}
+
+/*
+	"name: value" lines straight from the receive buffer, nothing is copied
+*/
+void HTTPRequest::printHeaders(std::ostream &out) const
+{
+	const char	*raw = this->_rawString.data();
+	for (size_t id = 0; id < HDR_KNOWN + this->_other.size(); ++id)
+	{
+		const HeaderField	&field = id < HDR_KNOWN ? this->_known[id] : this->_other[id - HDR_KNOWN];
+		if (field.nameLen == 0)
+			continue;
+		out.write(raw + field.name, static_cast<std::streamsize>(field.nameLen));
+		out << ": ";
+		out.write(raw + field.value, static_cast<std::streamsize>(field.valueLen));
+		out << '\n';
+	}
 }
 
 bool HTTPRequest::isHeaderComplete() const
 {
-	return (this->_headerComplete);
+	return (this->_state > PARSE_HEADERS && this->_state != PARSE_ERROR);
 }
 
 bool HTTPRequest::isBodyComplete() const
 {
-	return (this->_bodyComplete);
+	return (this->_state == PARSE_DONE);
+}
+
+bool HTTPRequest::hasError() const
+{
+	return (this->_state == PARSE_ERROR);
+}
+
+int HTTPRequest::getErrorStatus() const
+{
+	return (this->_errorStatus);
 }
 
 bool HTTPRequest::isConnectionAlive() const
@@ -122,6 +419,11 @@ const std::string &HTTPRequest::getMethod() const
 	return (this->_method);
 }
 
+HttpMethod HTTPRequest::getMethodId() const
+{
+	return (this->_methodId);
+}
+
 const std::string &HTTPRequest::getPath() const
 {
 	return (this->_path);
@@ -142,20 +444,20 @@ const int &HTTPRequest::getSocketFD() const
 	return (this->_socketFD);
 }
 
-/* Setters */
-void	HTTPRequest::setRawString(std::string &rawString)
+const std::string &HTTPRequest::getLocalAddress() const
 {
-	this->_rawString = rawString;
+	return (this->_localAddress);
 }
 
-void HTTPRequest::setRawHeader(const std::string &rawHeader)
+int HTTPRequest::getLocalPort() const
 {
-	this->_rawHeader = rawHeader;
+	return (this->_localPort);
 }
 
-void HTTPRequest::setRawBody(const std::string &rawBody)
+/* Setters */
+void	HTTPRequest::setRawString(std::string &rawString)
 {
-	this->_rawBody = rawBody;
+	this->_rawString = rawString;
 }
 
 void HTTPRequest::setConnectionAlive(const bool &connectionAlive)
@@ -163,19 +465,10 @@ void HTTPRequest::setConnectionAlive(const bool &connectionAlive)
 	this->_connectionAlive = connectionAlive;
 }
 
-void HTTPRequest::setHeaderMap(const std::map<std::string, std::string> &header)
-{
-	this->_header = header;
-}
-
-void HTTPRequest::setBodyVector(const std::vector<char> &body)
-{
-	this->_body = body;
-}
-
 void HTTPRequest::setMethod(const std::string &method)
 {
 	this->_method = method;
+	this->_methodId = parseMethod(method.data(), method.size());
 }
 
 void HTTPRequest::setPath(const std::string &path)
@@ -203,46 +496,193 @@ void HTTPRequest::setSocketFD(const int &socketFD)
 	this->_socketFD = socketFD;
 }
 
+void HTTPRequest::setLocalAddress(const std::string &address, int port)
+{
+	this->_localAddress = address;
+	this->_localPort = port;
+}
+
 /****************************** READING ***************************************** */
 
+/*
+	Append what arrived and run the state machine as far as the buffered bytes allow
+*/
 void	HTTPRequest::feed(std::string &data)
 {
-	this->_rawString += data;
+	this->feed(data.data(), data.size());
+}
+
+void	HTTPRequest::feed(const char *data, size_t length)
+{
+	this->_rawString.append(data, length);
+	this->parse();
+}
+
+void	HTTPRequest::setHeaderLimits(size_t lineMax, size_t headerMax, size_t countMax)
+{
+	this->_lineMax = lineMax;
+	this->_headerMax = headerMax;
+	this->_headerCountMax = countMax;
+}
 
-	if (this->_headerComplete == false)
+void	HTTPRequest::setBodyBuffer(size_t size, const std::string &tempPath)
+{
+	this->_bodyBufferMax = size;
+	this->_tempPath = tempPath;
+}
+
+bool	HTTPRequest::awaitingBodyLimit() const
+{
+	return (this->_state == PARSE_HEADERS_DONE);
+}
+
+/*
+	The body limit depends on the server and location the headers select, so the parser
+	stops after them until the caller looked it up. An announced length over the limit
+	fails right here, before a byte of the body is buffered. decode is the location's
+	decompress_request_body: off, an encoded body is kept as it was sent.
+*/
+void	HTTPRequest::setBodyLimit(size_t limit, bool decode)
+{
+	if (this->_state != PARSE_HEADERS_DONE)
+		return;
+	this->_bodyMax = limit;
+	if (decode && !this->startDecoder())
+		return;
+	if (this->_isChunked)
+		this->_state = PARSE_CHUNK_SIZE;
+	else if (this->_content_length > 0)
 	{
-		size_t	header_end = this->_rawString.find("\r\n\r\n");
-		if (header_end != std::string::npos) // found header-body separator
+		if (limit > 0 && this->_content_length > limit)
 		{
-			this->_headerComplete = true;
-			this->extractRequestLine();
-			this->_rawHeader = this->_rawString.substr(_request_line_len, header_end - _request_line_len);
-			this->extractHeader();
-			this->analyzeHeader();
+			this->fail(413);
+			return;
 		}
+		// an inflated body's size is only known as it grows: inflateBody() spills it
+		if (!this->_decoder && this->_content_length > this->_bodyBufferMax)
+		{
+			if (!this->openBodyFile())
+				return;
+		}
+		// the body lands in one allocation instead of a chain of doublings (each a copy)
+		else if (!this->_decoder && this->_content_length <= BODY_RESERVE_MAX)
+			this->_rawString.reserve(this->_scan + this->_content_length);
+		this->_state = PARSE_BODY;
 	}
-	// Process body after header complete
-	if (this->_headerComplete == true && this->_bodyComplete == false)
+	else
+		this->_state = PARSE_MULTIPART;
+	this->parse();
+}
+
+/*
+	The caller already queued the final response (Expect: 100-continue refused);
+	hasError() holds from here on, without a status of its own to answer with
+*/
+void	HTTPRequest::abandon()
+{
+	this->_state = PARSE_ERROR;
+	this->_errorStatus = 0;
+}
+
+/*
+	Run the state machine as far as the buffered bytes allow
+*/
+void	HTTPRequest::parse()
+{
+	bool	progress = true;
+	while (progress)
 	{
-		if (this->_isChunked == true)
-			this->processChunked();
-		else
-			this->processUnchunked();
+		switch (this->_state)
+		{
+			case PARSE_REQUEST_LINE:
+				progress = this->parseRequestLine();
+				break;
+			case PARSE_HEADERS:
+				progress = this->parseHeaderLine();
+				break;
+			case PARSE_BODY:
+				progress = this->parseBody();
+				break;
+			case PARSE_MULTIPART:
+				progress = this->parseMultipart();
+				break;
+			case PARSE_CHUNK_SIZE:
+				progress = this->parseChunkSize();
+				break;
+			case PARSE_CHUNK_DATA:
+				progress = this->parseChunkData();
+				break;
+			case PARSE_CHUNK_TRAILER:
+				progress = this->parseChunkTrailer();
+				break;
+			default: // PARSE_HEADERS_DONE, PARSE_DONE, PARSE_ERROR
+				progress = false;
+		}
+	}
+}
+
+/*
+	Next complete line from the scan cursor, without its CRLF (a bare LF is accepted too).
+	An incomplete line is not searched again: the next call resumes where this one stopped.
+*/
+bool	HTTPRequest::nextLine(size_t &start, size_t &length)
+{
+	size_t	newline = scanFind(this->_rawString, '\n', this->_searchFrom);
+	if (newline == std::string::npos)
+	{
+		this->_searchFrom = this->_rawString.size();
+		return (false);
 	}
+	start = this->_scan;
+	length = newline - start;
+	if (length > 0 && this->_rawString[newline - 1] == '\r')
+		--length;
+	this->_scan = newline + 1;
+	this->_searchFrom = this->_scan;
+	return (true);
+}
+
+bool	HTTPRequest::fail(int status)
+{
+	this->_state = PARSE_ERROR;
+	this->_errorStatus = status;
+	std::cerr << YELLOW << "Request rejected, answering " << status << RESET << std::endl;
+	return (false);
 }
 
 /************************************ REQUEST LINE ******************************* */
-void	HTTPRequest::extractRequestLine()
+bool	HTTPRequest::parseRequestLine()
 {
-	if (this->_rawString.empty())
-		throw (HTTPRequest::EmptyRawString());
-	size_t crlf = this->_rawString.find("\r\n");
-	if (crlf == std::string::npos)
-		throw (HTTPRequest::EmptyRawString());
-	std::string current_line = this->_rawString.substr(0, crlf);
-	// Now _request_line_len includes the CRLF
-	this->_request_line_len = crlf + 2;
-	this->processRequestLine(current_line);
+	size_t	start;
+	size_t	length;
+	if (!this->nextLine(start, length))
+	{
+		// no need to wait for the end of a line that is already too long
+		if (this->_rawString.size() - this->_scan > this->_lineMax)
+			return (this->fail(414));
+		return (false);
+	}
+	// empty lines before the request line are allowed (RFC 9112 §2.2), a header block's worth of them
+	if (length == 0)
+	{
+		if (this->_scan - this->_requestStart > this->_headerMax)
+			return (this->fail(400));
+		return (true);
+	}
+	if (length > this->_lineMax)
+		return (this->fail(414));
+	std::string	line = this->_rawString.substr(start, length);
+	this->processRequestLine(line);
+	if (this->_method.empty() || this->_path.empty() || this->_version.empty())
+		return (this->fail(400));
+	if (this->_version != "HTTP/1.1" && this->_version != "HTTP/1.0")
+		return (this->fail(this->_version.compare(0, 5, "HTTP/") == 0 ? 505 : 400));
+	// decoded and dot-segment free from here on, or refused
+	if (this->_path[0] == '/' && !normalizeUriPath(this->_path))
+		return (this->fail(400));
+	this->_headerStart = this->_scan;
+	this->_state = PARSE_HEADERS;
+	return (true);
 }
 
 void	HTTPRequest::processRequestLine(std::string &line)
@@ -256,6 +696,7 @@ void	HTTPRequest::processRequestLine(std::string &line)
 
 	line_stream >> method >> target >> version;
 	this->_method = method;
+	this->_methodId = parseMethod(method.data(), method.size());
 	this->_version = version;
 
 	// Split request-target into path + query (RFC 9112 §3.2)
@@ -318,113 +759,173 @@ void	HTTPRequest::trimSpaces(std::string &line)
 
 /*************************HEADER***************************** */
 
-void	HTTPRequest::extractHeader()
+/*
+	One header line per call; the empty line ends the header block and picks the body framing
+*/
+bool	HTTPRequest::parseHeaderLine()
 {
-	std::string	key;
-	std::string	value;
-	size_t	colon_index = 0;
-	std::istringstream	stream(this->_rawHeader);
-	std::string	line;
-
-	if (_rawHeader.empty())
-		throw (HTTPRequest::EmptyRawHeader());
-	while (std::getline(stream, line))
+	size_t	start;
+	size_t	length;
+	if (!this->nextLine(start, length))
 	{
-		this->trimBackslashR(line);
-		if (line.empty())
-			continue;
-		colon_index = line.find(":");
-		if (colon_index == std::string::npos)
+		// a line longer than one buffer, or a block longer than all of them
+		if (this->_rawString.size() - this->_scan > this->_lineMax
+			|| this->_rawString.size() - this->_requestStart > this->_headerMax)
+			return (this->fail(431));
+		return (false);
+	}
+	if (length == 0)
+	{
+		this->_headerEnd = start;
+		if (!this->analyzeHeader())
+			return (false);
+		this->_bodyStart = this->_scan;
+		if (this->_isChunked || this->_content_length > 0 || this->_useMultipartBoundary)
 		{
-			std::cerr << YELLOW << "Malformed header line: " << line << RESET << std::endl;
-			continue;
+			// the caller picks the limit from the matched server / location first
+			this->_state = PARSE_HEADERS_DONE;
+			return (false);
 		}
-		key = line.substr(0, colon_index);
-		value = line.substr(colon_index + 1);
+		this->_state = PARSE_DONE; // no explicit framing: empty body (e.g. GET requests)
+		return (true);
+	}
+	if (length > this->_lineMax || this->_scan - this->_requestStart > this->_headerMax
+		|| ++this->_headerCount > this->_headerCountMax)
+		return (this->fail(431));
+	const char	*line = this->_rawString.data() + start;
+	// obsolete line folding is rejected (RFC 9112 §5.2)
+	if (line[0] == ' ' || line[0] == '\t')
+		return (this->fail(400));
+	const char	*colon = scanByte(line, line + length, ':');
+	if (colon == line + length || colon == line)
+		return (this->fail(400));
+
+	HeaderField	field;
+	field.name = start;
+	field.nameLen = static_cast<size_t>(colon - line);
+	while (field.nameLen > 0 && (line[field.nameLen - 1] == ' ' || line[field.nameLen - 1] == '\t'))
+		--field.nameLen;
+	if (field.nameLen == 0)
+		return (this->fail(400));
+	// value without the optional whitespace around it
+	size_t	first = static_cast<size_t>(colon - line) + 1;
+	size_t	last = length;
+	while (first < last && (line[first] == ' ' || line[first] == '\t'))
+		++first;
+	while (last > first && (line[last - 1] == ' ' || line[last - 1] == '\t'))
+		--last;
+	field.value = start + first;
+	field.valueLen = last - first;
+
+	HeaderId	id = lookupHeader(line, field.nameLen);
+	if (id == HDR_OTHER)
+	{
+		this->_other.push_back(field);
+		return (true);
+	}
+	// two different lengths would let a proxy and us disagree on where the body ends
+	if (id == HDR_CONTENT_LENGTH && this->_known[id].nameLen > 0
+		&& (this->_known[id].valueLen != field.valueLen
+			|| this->_rawString.compare(this->_known[id].value, field.valueLen, this->_rawString, field.value, field.valueLen) != 0))
+		return (this->fail(400));
+	this->_known[id] = field; // a repeated name keeps the last value
+	return (true);
+}
+
+void	HTTPRequest::clearHeaders()
+{
+	for (size_t id = 0; id < HDR_KNOWN; ++id)
+		this->_known[id].nameLen = 0;
+	this->_other.clear(); // keeps its capacity for the next request on the connection
+}
+
+/*
+	A name that is not known is looked up in the flat list, the last occurrence wins
+*/
+const HTTPRequest::HeaderField	*HTTPRequest::findHeader(const std::string &name) const
+{
+	HeaderId	id = lookupHeader(name.data(), name.size());
+	if (id != HDR_OTHER)
+		return (this->_known[id].nameLen > 0 ? &this->_known[id] : NULL);
+	for (size_t i = this->_other.size(); i > 0; --i)
+	{
+		const HeaderField	&field = this->_other[i - 1];
+		if (field.nameLen == name.size() && equalsNoCase(this->_rawString.data() + field.name, name.data(), name.size()))
+			return (&field);
+	}
+	return (NULL);
+}
 
-		// Trim the leading/trailing spaces
-		this->trimSpaces(key);
-		this->trimSpaces(value);
+std::string	HTTPRequest::sliceString(size_t offset, size_t length) const
+{
+	return (this->_rawString.substr(offset, length));
+}
 
-		// Convert header key to lower case for case insensitive
-		for (size_t i = 0; i < key.length(); i++)
-			key[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(key[i])));
-		this->_header[key] = value;
+/*
+	Case-insensitive search for a lowercase token inside a header value
+*/
+bool	HTTPRequest::sliceContains(const HeaderField &field, const char *token) const
+{
+	size_t	tokenLen = std::strlen(token);
+	if (field.nameLen == 0 || tokenLen > field.valueLen)
+		return (false);
+	const char	*value = this->_rawString.data() + field.value;
+	for (size_t i = 0; i + tokenLen <= field.valueLen; ++i)
+	{
+		if (equalsNoCase(value + i, token, tokenLen))
+			return (true);
 	}
+	return (false);
 }
 
-void HTTPRequest::analyzeHeader()
+bool HTTPRequest::analyzeHeader()
 {
 	this->checkChunked();
-	if (this->_isChunked == false)
-		this->checkContentLength();
+	if (this->_isChunked == false && !this->checkContentLength())
+		return (this->fail(400));
 	this->processConnection();
 	// Multipart fallback: only when not chunked AND no Content-Length
 	if (_isChunked == false && _content_length == 0 && hasMultipart() == true)
 	{
-		std::map<std::string, std::string>::const_iterator it = _header.find("content-type");
-		if (it != _header.end())
+		std::string found;
+		bool ok = extractBoundary(this->getHeader(HDR_CONTENT_TYPE), found);
+		if (ok == true)
 		{
-			std::string found;
-			bool ok = extractBoundary(it->second, found);
-			if (ok == true)
-			{
-				_boundary = found;
-				_useMultipartBoundary = true;
-			}
+			_boundary = found;
+			_useMultipartBoundary = true;
 		}
 	}
+	return (true);
 }
 
 
 void HTTPRequest::checkChunked()
 {
-	std::map<std::string, std::string>::iterator it = _header.find("transfer-encoding");
-
-	if (it == _header.end())
-	{
-		_isChunked = false;
-		return;
-	}
-
-	std::string value = it->second;
-
-	for (size_t i = 0; i < value.size(); ++i)
-	{
-		value[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(value[i])));
-	}
-
-	if (value.find("chunked") != std::string::npos)
-	{
-		_isChunked = true;
-	}
-	else
-	{
-		_isChunked = false;
-	}
+	_isChunked = this->headerContains(HDR_TRANSFER_ENCODING, "chunked");
 }
 
 
-void	HTTPRequest::checkContentLength()
+/*
+	Content-Length must be plain digits; false if it is not (or would overflow)
+*/
+bool	HTTPRequest::checkContentLength()
 {
-	std::map<std::string, std::string>::iterator it = _header.find("content-length");
+	const HeaderField	&field = this->_known[HDR_CONTENT_LENGTH];
 
-	if (it != _header.end()) // found key
+	if (field.nameLen == 0) // no body announced
+		return (true);
+	if (field.valueLen == 0 || field.valueLen > 18)
+		return (false);
+	size_t	len = 0;
+	for (size_t i = 0; i < field.valueLen; ++i)
 	{
-		std::istringstream	stream(it->second);
-		size_t	len;
-
-		stream >> len;
-		if (stream.fail())
-			throw (HTTPRequest::ContentLengthConversionFailed());
-		else
-		{
-			std::cout << "Converted value: " << len << std::endl;
-			this->_content_length = len;
-		}
+		char	c = this->_rawString[field.value + i];
+		if (c < '0' || c > '9')
+			return (false);
+		len = len * 10 + static_cast<size_t>(c - '0');
 	}
-	else
-		std::cerr << "There is no content-length in the header!\n";
+	this->_content_length = len;
+	return (true);
 }
 
 /*
@@ -433,72 +934,21 @@ void	HTTPRequest::checkContentLength()
 */
 void	HTTPRequest::processConnection()
 {
-	const std::string version = this->_version;
-	const std::map<std::string, std::string> header = this->_header;
-
-	std::map<std::string, std::string>::const_iterator it = header.find("connection");
-	bool hasConnection = false;
-	if (it != header.end())
-		hasConnection = true;
-	std::string	connection = "";
-	if (hasConnection == true)
-		connection = it->second;
-	
-	// Make all words lowercase
-	for (size_t	i = 0; i < connection.size(); ++i)
-		connection[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(connection[i])));
-	this->_connectionAlive = evaluateAlive(version, hasConnection, connection);
+	this->_connectionAlive = evaluateAlive(this->_version, this->_known[HDR_CONNECTION]);
 }
 
-bool	HTTPRequest::evaluateAlive(const std::string version, const bool hasConnection, const std::string connection)
+bool	HTTPRequest::evaluateAlive(const std::string &version, const HeaderField &connection) const
 {
 	if (version == "HTTP/1.1")
-	{
-		if (hasConnection == true)
-		{
-			if (connection.find("close") == std::string::npos)
-				return (true);
-			else
-				return (false);
-		}
-		return (true);
-	}
+		return (!this->sliceContains(connection, "close"));
 	if (version == "HTTP/1.0")
-	{
-		if (hasConnection == true)
-		{
-			if (connection.find("keep-alive") != std::string::npos)
-				return (true);
-			else
-				return (false);
-		}
-		return (false);
-	}
+		return (this->sliceContains(connection, "keep-alive"));
 	return (false);
 }
 
 bool HTTPRequest::hasMultipart() const
 {
-    std::map<std::string, std::string>::const_iterator it = _header.find("content-type");
-
-    if (it == _header.end())
-    {
-        return (false);
-    }
-
-    std::string ctype = it->second;
-
-    for (size_t i = 0; i < ctype.size(); ++i)
-    {
-        ctype[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(ctype[i])));
-    }
-
-    if (ctype.find("multipart/form-data") != std::string::npos)
-    {
-        return (true);
-    }
-
-    return (false);
+	return (this->headerContains(HDR_CONTENT_TYPE, "multipart/form-data"));
 }
 
 bool HTTPRequest::extractBoundary(const std::string &ctype, std::string &outBoundary) const
@@ -544,163 +994,433 @@ bool HTTPRequest::extractBoundary(const std::string &ctype, std::string &outBoun
 
 
 /*********************BODY******************************* */
-/********************CHUNKED********************************* */
-void	HTTPRequest::processChunked()
+/****************************UNCHUNKED*************************** */
+bool	HTTPRequest::parseBody()
 {
-	if (_bodyPos == 0)
-		this->skipHeader();
-	while (_chunkedComplete == false && _bodyPos < _rawString.size())
+	if (this->_bodyFile || this->_decoder)
 	{
-		if (_chunkSize == 0 && readChunkSize() == false)
-			break;
-		if (_chunkSize == 0) // received chunksize and it's 0\r\n
+		size_t	consumed;
+		if (!this->streamBody(this->_content_length - this->_received, consumed))
+			return (false);
+		this->_received += consumed;
+		if (this->_received < this->_content_length)
+			return (false);
+		return (this->finishBody());
+	}
+	if (this->_rawString.size() - this->_scan < this->_content_length)
+		return (false); // wait for the rest, nothing is rescanned meanwhile
+	this->_bodyLength = this->_content_length;
+	this->_scan += this->_content_length;
+	this->_searchFrom = this->_scan;
+	this->_state = PARSE_DONE;
+	return (true);
+}
+
+/*
+	Multipart with boundary, no Content-Length (fallback).
+	The closing marker search resumes just before the previous end of data,
+	so a marker split across two reads is still found. Past the body buffer size
+	the body goes to the temp file as it arrives, all but a marker's length of tail
+	that may hold the start of the marker.
+*/
+bool	HTTPRequest::parseMultipart()
+{
+	// Closing sequence is typically "\r\n--<boundary>--\r\n"
+	std::string closing = "\r\n--";
+	closing += _boundary;
+	closing += "--";
+
+	size_t	from = std::max(this->_searchFrom, this->_scan);
+	size_t	pos = scanFind(this->_rawString, closing, from);
+	if (pos == std::string::npos)
+	{
+		// _bodyLength: bytes already in the temp file
+		size_t	buffered = this->_rawString.size() - this->_scan;
+		// more than the limit received and the closing marker still missing
+		if (this->_bodyMax > 0 && this->_bodyLength + buffered > this->_bodyMax + closing.size() + 2)
+			return (this->fail(413));
+		if (buffered > closing.size() && (this->_bodyFile || buffered > this->_bodyBufferMax))
 		{
-			if (checkLastChunk() == false)
-				break;
+			if (!this->_bodyFile && !this->openBodyFile())
+				return (false);
+			if (!this->spill(buffered - closing.size()))
+				return (false);
 		}
-		if (readChunkData() == false)
-			break;
+		if (this->_rawString.size() >= closing.size())
+			this->_searchFrom = std::max(this->_scan, this->_rawString.size() - closing.size() + 1);
+		return (false);
+	}
+	// Body ends right before the CRLF that precedes the closing marker.
+	if (this->_bodyFile)
+	{
+		if (!this->spill(pos - this->_scan))
+			return (false);
+		pos = this->_scan; // the marker now follows the headers
 	}
+	else
+		this->_bodyLength = pos - this->_bodyStart;
+
+	// move past "\r\n--<boundary>--", some clients send a final "\r\n" too
+	size_t message_end = pos + closing.size();
+	if (this->_rawString.compare(message_end, 2, "\r\n") == 0)
+		message_end += 2;
+	this->_scan = message_end;
+	this->_searchFrom = message_end;
+	return (this->finishBody());
 }
 
-void	HTTPRequest::skipHeader()
+/********************CHUNKED********************************* */
+/*
+	"<hex size>[;extensions]" line; size 0 is the last chunk
+*/
+bool	HTTPRequest::parseChunkSize()
 {
-	size_t	header_end = this->_rawString.find("\r\n\r\n");
-	size_t	body_start = header_end + 4; // to skip "\r\n\r\n"
-	_bodyPos = body_start;
+	size_t	start;
+	size_t	length;
+	if (!this->nextLine(start, length))
+	{
+		// a size line (extensions included) gets no more room than a header line
+		if (this->_rawString.size() - this->_scan > this->_lineMax)
+			return (this->fail(400));
+		return (false);
+	}
+	if (length > this->_lineMax)
+		return (this->fail(400));
+	std::string	line = this->_rawString.substr(start, length);
+	size_t	ext = line.find(';');
+	if (ext != std::string::npos)
+		line.erase(ext);
+	this->trimSpaces(line);
+	// at most 15 hex digits so the size cannot overflow
+	if (line.empty() || line.size() > 15 || line.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+		return (this->fail(400));
+	std::istringstream	stream(line);
+	stream >> std::hex >> this->_chunkSize;
+	// the running total is checked per chunk, before its data is waited for
+	if (this->_bodyMax > 0 && this->_chunkSize > this->_bodyMax - this->_received)
+		return (this->fail(413));
+	if (!this->_bodyFile && !this->_decoder && this->_chunkSize > this->_bodyBufferMax - std::min(this->_bodyLength, this->_bodyBufferMax)
+		&& !this->openBodyFile())
+		return (false);
+	if (!this->_bodyFile && !this->_decoder)
+	{
+		/*
+			The size lines consumed since the body's end stay in the buffer until the next
+			chunk's data moves down over them; once they outgrow the body buffer they are
+			cut out, so tiny chunks with long lines cannot pile up framing in memory
+		*/
+		size_t	bodyEnd = this->_bodyStart + this->_bodyLength;
+		if (this->_scan - bodyEnd > this->_bodyBufferMax)
+		{
+			this->_rawString.erase(bodyEnd, this->_scan - bodyEnd);
+			this->_scan = bodyEnd;
+			this->_searchFrom = bodyEnd;
+		}
+	}
+	if (this->_chunkSize == 0)
+	{
+		this->_headerCount = 0; // the trailer section gets a header block's budget of its own
+		this->_trailerSize = 0;
+	}
+	this->_state = (this->_chunkSize == 0) ? PARSE_CHUNK_TRAILER : PARSE_CHUNK_DATA;
+	return (true);
 }
 
-bool	HTTPRequest::readChunkSize()
+bool	HTTPRequest::parseChunkData()
 {
-	size_t	end_line = _rawString.find("\r\n", _bodyPos);
-	if (end_line != std::string::npos) // found
+	if (this->_bodyFile || this->_decoder)
 	{
-		std::string	line = _rawString.substr(_bodyPos, end_line - _bodyPos);
-		std::istringstream	stream(line);
-		stream >> std::hex >> _chunkSize;
-		_bodyPos = end_line + 2; // skip the digit and trailling /r/n (e.g. 4/r/n)
+		// streamed: the chunk is written out / inflated as it arrives, _chunkSize is what is left of it
+		size_t	consumed;
+		if (!this->streamBody(this->_chunkSize, consumed))
+			return (false);
+		this->_chunkSize -= consumed;
+		this->_received += consumed;
+		if (this->_chunkSize > 0 || this->_rawString.size() - this->_scan < 2)
+			return (false);
+		if (this->_rawString.compare(this->_scan, 2, "\r\n") != 0)
+			return (this->fail(400));
+		this->_scan += 2;
+		this->_searchFrom = this->_scan;
+		this->_state = PARSE_CHUNK_SIZE;
 		return (true);
 	}
-	else
-		return (false); // because couldn't find a newline, need to fetch data
+	// chunk data plus its CRLF
+	if (this->_rawString.size() - this->_scan < this->_chunkSize + 2)
+		return (false);
+	if (this->_rawString.compare(this->_scan + this->_chunkSize, 2, "\r\n") != 0)
+		return (this->fail(400));
+	// move the data down over the size line(s) so the body stays one contiguous slice
+	size_t	bodyEnd = this->_bodyStart + this->_bodyLength;
+	if (bodyEnd != this->_scan && this->_chunkSize > 0)
+		std::memmove(&this->_rawString[bodyEnd], &this->_rawString[this->_scan], this->_chunkSize);
+	this->_bodyLength += this->_chunkSize;
+	this->_received += this->_chunkSize;
+	this->_scan += this->_chunkSize + 2;
+	this->_searchFrom = this->_scan;
+	this->_chunkSize = 0;
+	this->_state = PARSE_CHUNK_SIZE;
+	return (true);
 }
 
-bool	HTTPRequest::checkLastChunk()
+/*
+	Trailer fields after the last chunk are skipped up to the empty line
+	(Handle 0\r\n[trailer-headers]\r\n\r\n). They are held to the header limits
+	and dropped from the buffer as they are read.
+*/
+bool	HTTPRequest::parseChunkTrailer()
 {
-	// Look for final CRLF of last chunk 
-	size_t	trailer_start = _bodyPos;
-	size_t	trailer_end = _rawString.find("\r\n\r\n", trailer_start);
-
-	// Found complete trailer section (Handle 0\r\n[trailer-headers]\r\n\r\n)
-	if (trailer_end != std::string::npos)
+	size_t	start;
+	size_t	length;
+	if (!this->nextLine(start, length))
 	{
-		_chunkedComplete = true;
-		_bodyComplete = true;
-		_bodyPos = trailer_end + 4;
-		return (true);
+		if (this->_rawString.size() - this->_scan > this->_lineMax)
+			return (this->fail(400));
+		if (this->_trailerSize + this->_rawString.size() - this->_scan > this->_headerMax)
+			return (this->fail(431));
+		return (false);
 	}
+	if (length == 0)
+		return (this->finishBody());
+	if (length > this->_lineMax)
+		return (this->fail(400));
+	this->_trailerSize += this->_scan - start;
+	if (this->_trailerSize > this->_headerMax || ++this->_headerCount > this->_headerCountMax)
+		return (this->fail(431));
+	this->_rawString.erase(start, this->_scan - start);
+	this->_scan = start;
+	this->_searchFrom = start;
+	return (true);
+}
 
-	// handle simple "\r\n" if no trailer headers
-	// Handle 0\r\n\r\n
-	if (_rawString.substr(_bodyPos, 2) == "\r\n")
+/*
+	The framed body is all in; an inflated one must have reached the end of its stream
+*/
+bool	HTTPRequest::finishBody()
+{
+	if (this->_decoder)
 	{
-		_chunkedComplete = true;
-		_bodyComplete = true;
-		_bodyPos += 2;
-		return (true);
+		bool	ended = this->_decoder->inflater.finished();
+		this->releaseDecoder();
+		if (!ended)
+			return (this->fail(400));
+		this->_bodyDecoded = true;
 	}
-	return (false);
+	this->_state = PARSE_DONE;
+	if (this->_bodyFile)
+		return (this->mapBodyFile());
+	return (true);
 }
 
-bool	HTTPRequest::readChunkData()
+/*************************** SPILLED BODY ******************************* */
+
+/*
+	Take up to max framed body bytes from the cursor into the temp file, or through the
+	inflater; consumed is how many were taken
+*/
+bool	HTTPRequest::streamBody(size_t max, size_t &consumed)
 {
-	if (_rawString.size() < _bodyPos + _chunkSize + 2) // current raw data has fewer data than required
+	if (this->_decoder)
+		return (this->inflateBody(max, consumed));
+	size_t	before = this->_bodyLength;
+	if (!this->spill(max))
 		return (false);
-	std::string	chunk = _rawString.substr(_bodyPos, _chunkSize);
-	_rawBody += chunk; // store the data
-	_body.insert(_body.end(), chunk.begin(), chunk.end()); // store in the vector
-	_bodyPos += _chunkSize + 2; // skip the trailing /r/n && chunk body
-	_chunkSize = 0; // reset
+	consumed = this->_bodyLength - before;
 	return (true);
 }
 
-/****************************UNCHUNKED*************************** */
-void HTTPRequest::processUnchunked()
+/*
+	Create the temp file (unlinked at once, so nothing is left behind whatever happens
+	to the process) and move the body buffered so far into it
+*/
+bool	HTTPRequest::openBodyFile()
 {
-	size_t header_end = this->_rawString.find("\r\n\r\n");
-	if (header_end == std::string::npos)
-		return;
-	size_t body_start = header_end + 4;
-	// Case 1: Content-Length framing
-	if (_content_length > 0)
+	std::string	pattern = this->_tempPath + "/webserv_body_XXXXXX";
+	std::vector<char>	name(pattern.begin(), pattern.end());
+	name.push_back('\0');
+	int	fd = mkstemp(&name[0]);
+	if (fd < 0)
 	{
-		if (this->_rawString.size() >= body_start + _content_length)
-		{
-			std::string text = this->_rawString.substr(body_start, _content_length);
-
-			this->_rawBody = text;
-			this->_body.insert(_body.end(), text.begin(), text.end());
-			this->_bodyComplete = true;
-		}
-		return;
+		std::cerr << RED << "client_body_temp_path " << this->_tempPath << ": " << std::strerror(errno) << RESET << std::endl;
+		return (this->fail(500));
 	}
+	unlink(&name[0]);
+	fcntl(fd, F_SETFD, FD_CLOEXEC); // not inherited by CGI children of other requests
+	this->_bodyFile = new BodyFile();
+	this->_bodyFile->fd = fd;
+	this->_bodyFile->refs = 1;
+	this->_bodyFile->map = NULL;
+	this->_bodyFile->mapLength = 0;
+
+	size_t	buffered = this->_bodyLength;
+	this->_bodyLength = 0;
+	size_t	scan = this->_scan;
+	this->_scan = this->_bodyStart;
+	if (!this->spill(buffered))
+		return (false);
+	// chunk framing consumed after the buffered data goes too
+	this->_rawString.erase(this->_bodyStart, scan - buffered - this->_bodyStart);
+	this->_scan = this->_bodyStart;
+	this->_searchFrom = this->_scan;
+	return (true);
+}
 
-	// Case 2: Multipart with boundary, no Content-Length (fallback)
-	if (_useMultipartBoundary == true && _boundary.empty() == false)
-	{
-		// Closing sequence is typically "\r\n--<boundary>--\r\n"
-		std::string closing = "\r\n--";
-		closing += _boundary;
-		closing += "--";
-
-		size_t pos = this->_rawString.find(closing, body_start);
+/*
+	Append up to max bytes from the cursor to the temp file and drop them, together with
+	whatever else was consumed since the headers (chunk size lines), from the buffer.
+	The headers stay, their slices point into it.
+*/
+bool	HTTPRequest::spill(size_t max)
+{
+	size_t	length = std::min(this->_rawString.size() - this->_scan, max);
+	if (!this->writeBody(this->_rawString.data() + this->_scan, length))
+		return (false);
+	this->_rawString.erase(this->_bodyStart, this->_scan + length - this->_bodyStart);
+	this->_scan = this->_bodyStart;
+	this->_searchFrom = this->_scan;
+	this->_bodyLength += length;
+	return (true);
+}
 
-		if (pos != std::string::npos)
+bool	HTTPRequest::writeBody(const char *data, size_t length)
+{
+	size_t	done = 0;
+	while (done < length)
+	{
+		ssize_t	n = write(this->_bodyFile->fd, data + done, length - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
 		{
-			// Body ends right before the CRLF that precedes the closing marker.
-			std::string text = this->_rawString.substr(body_start, pos - body_start);
-
-			this->_rawBody = text;
-			this->_body.assign(text.begin(), text.end());
-			this->_bodyComplete = true;
-
-			// Compute end-of-message position:
-			// 1) move past "\r\n--<boundary>--"
-			size_t message_end = pos + closing.size();
-
-			// 2) some clients send a final "\r\n" after the closing boundary
-			if (this->_rawString.size() >= message_end + 2)
-			{
-				if (this->_rawString.substr(message_end, 2) == "\r\n")
-					message_end += 2;
-			}
-
-			// Store like chunked path does, so endOfMessageOffset() can use it
-			this->_bodyPos = message_end;
+			std::cerr << RED << "Request body temp file: " << std::strerror(errno) << RESET << std::endl;
+			return (this->fail(500));
 		}
+		done += static_cast<size_t>(n);
+	}
+	return (true);
+}
 
-		return;
+/*
+	The complete body, read-only: pages come from the page cache as they are touched
+	and can be dropped again under memory pressure
+*/
+bool	HTTPRequest::mapBodyFile()
+{
+	if (this->_bodyLength == 0)
+		return (true);
+	void	*map = mmap(NULL, this->_bodyLength, PROT_READ, MAP_PRIVATE, this->_bodyFile->fd, 0);
+	if (map == MAP_FAILED)
+	{
+		std::cerr << RED << "Request body temp file mmap: " << std::strerror(errno) << RESET << std::endl;
+		return (this->fail(500));
+	}
+	this->_bodyFile->map = static_cast<char *>(map);
+	this->_bodyFile->mapLength = this->_bodyLength;
+	return (true);
 }
 
-	// No explicit framing → treat as empty body (e.g. GET requests)
-	this->_bodyComplete = true;
-	this->_bodyPos = body_start;
+void	HTTPRequest::releaseBodyFile()
+{
+	if (this->_bodyFile && --this->_bodyFile->refs == 0)
+	{
+		if (this->_bodyFile->map)
+			munmap(this->_bodyFile->map, this->_bodyFile->mapLength);
+		close(this->_bodyFile->fd);
+		delete this->_bodyFile;
+	}
+	this->_bodyFile = NULL;
 }
 
-/******************EXCEPTION******************* */
-const char *HTTPRequest::EmptyRawString::what() const throw()
+/*************************** ENCODED BODY ******************************* */
+
+/*
+	Content-Encoding the body is inflated from: gzip or deflate, one coding only.
+	Anything else is refused (415) rather than handed on as if it were plain, and so is
+	an encoded body without a length or chunked framing, whose end could not be found.
+*/
+bool	HTTPRequest::startDecoder()
 {
-	return ("Invalid Raw String: Empty Raw String!");
+	const HeaderField	&field = this->_known[HDR_CONTENT_ENCODING];
+	if (field.nameLen == 0)
+		return (true);
+	ContentCoding	coding = parseContentCoding(this->_rawString.data() + field.value, field.valueLen);
+	if (coding == CODING_IDENTITY)
+		return (true);
+	if (coding == CODING_UNKNOWN || !BodyInflater::available())
+		return (this->fail(415));
+	if (!this->_isChunked && this->_content_length == 0)
+		return (this->fail(411));
+	this->_decoder = new BodyDecoder();
+	this->_decoder->refs = 1;
+	if (!this->_decoder->inflater.start(coding))
+		return (this->fail(500));
+	return (true);
 }
 
-const char *HTTPRequest::EmptyRawHeader::what() const throw()
+/*
+	Inflate up to max framed bytes from the cursor. In memory the output replaces the
+	input it came from (and any chunk framing in front of it), so the body stays one
+	slice ending at the cursor; once it outgrows the buffer it goes to the temp file like
+	a plain body. The limit is checked on every step, so a small bomb fails as soon as
+	it has inflated past it.
+*/
+bool	HTTPRequest::inflateBody(size_t max, size_t &consumed)
 {
-	return ("Invalid Raw Header: Empty Raw Header!");
+	char	out[INFLATE_CHUNK];
+	size_t	available = std::min(this->_rawString.size() - this->_scan, max);
+	consumed = 0;
+	while (true)
+	{
+		size_t	used;
+		size_t	produced;
+		BodyInflater::Status	status = this->_decoder->inflater.run(this->_rawString.data() + this->_scan,
+			available - consumed, used, out, sizeof(out), produced);
+		if (status == BodyInflater::INFLATE_ERROR)
+			return (this->fail(400));
+		if (this->_bodyMax > 0 && produced > this->_bodyMax - this->_bodyLength)
+			return (this->fail(413));
+		if (!this->_bodyFile && produced > this->_bodyBufferMax - std::min(this->_bodyLength, this->_bodyBufferMax)
+			&& !this->openBodyFile())
+			return (false);
+		if (this->_bodyFile)
+		{
+			// the input taken is dropped once, after the loop
+			if (!this->writeBody(out, produced))
+				return (false);
+			this->_scan += used;
+		}
+		else
+		{
+			size_t	bodyEnd = this->_bodyStart + this->_bodyLength;
+			this->_rawString.replace(bodyEnd, this->_scan + used - bodyEnd, out, produced);
+			this->_scan = bodyEnd + produced;
+		}
+		this->_bodyLength += produced;
+		consumed += used;
+		if (status == BodyInflater::INFLATE_END)
+		{
+			// nothing may follow the end of the compressed stream
+			if (consumed < available)
+				return (this->fail(400));
+			break;
+		}
+		if (used == 0 && produced == 0)
+			break; // needs the next bytes
+	}
+	if (this->_bodyFile)
+	{
+		this->_rawString.erase(this->_bodyStart, this->_scan - this->_bodyStart);
+		this->_scan = this->_bodyStart;
+	}
+	this->_searchFrom = this->_scan;
+	return (true);
 }
 
-const char *HTTPRequest::ContentLengthConversionFailed::what() const throw()
+void	HTTPRequest::releaseDecoder()
 {
-	return ("Invalid Header Value: Conversion Content-Length Failed!");
+	if (this->_decoder && --this->_decoder->refs == 0)
+		delete this->_decoder;
+	this->_decoder = NULL;
 }
 
 /***************************************** Utility *************************************/
@@ -721,50 +1441,63 @@ std::string	HTTPRequest::connectionHeader(bool keep) const
 }
 
 /*
-	Reset internal state so the same TCP connection can accept another request
+	Reset internal state so the same TCP connection can accept another request.
+	Bytes already buffered past the finished request (pipelining) stay in place and are
+	parsed from the cursor. The consumed prefix is erased only when it passed
+	PIPELINE_COMPACT and is at least as long as what follows it, so moving the tail
+	down is paid for by the bytes consumed: a deep pipeline costs linear time overall.
+
+	The header limits and body buffer settings stay, they belong to the connection.
 
 	NOTE: _connectionAlive remains whatever was decided for the *just served* request.
 	It will be recomputed on the next request's headers.
 */
 void HTTPRequest::resetForNextRequest()
 {
-	_rawString.clear();
-	_rawHeader.clear();
-	_rawBody.clear();
-	_header.clear();
-	_body.clear();
-	_headerComplete = false;
-	_bodyComplete = false;
+	if (_scan >= _rawString.size())
+	{
+		if (_rawString.capacity() > REQUEST_KEEP_CAPACITY)
+			std::string().swap(_rawString); // do not keep an upload's worth of memory per connection
+		else
+			_rawString.clear();
+		_scan = 0;
+	}
+	else if (_scan >= PIPELINE_COMPACT && _scan >= _rawString.size() - _scan)
+	{
+		_rawString.erase(0, _scan);
+		_scan = 0;
+	}
+	clearHeaders();
+	releaseBodyFile();
+	releaseDecoder();
+	_bodyStart = 0;
+	_bodyLength = 0;
+	_received = 0;
+	_bodyDecoded = false;
+	_state = PARSE_REQUEST_LINE;
+	_requestStart = _scan;
+	_searchFrom = _scan;
+	_headerStart = _scan;
+	_headerEnd = _scan;
+	_errorStatus = 0;
+	_headerCount = 0;
+	_bodyMax = 0;
 	_isChunked = false;
-	_chunkedComplete = false;
-	_bodyPos = 0;
 	_chunkSize = 0;
+	_trailerSize = 0;
 	_content_length = 0;
 	_request_line.clear();
-	_request_line_len = 0;
 	_method.clear();
+	_methodId = METHOD_UNKNOWN;
 	_path.clear();
 	_query.clear();
 	_version.clear();
 	_useMultipartBoundary = false;
 	_boundary.clear();
+	parse();
 }
 
-size_t HTTPRequest::endOfMessageOffset() const
+bool HTTPRequest::hasPendingData() const
 {
-	size_t header_end = _rawString.find("\r\n\r\n");
-	if (header_end == std::string::npos)
-		return (0);
-
-	size_t body_start = header_end + 4;
-
-	// If chunked, or if we computed a message-end position (multipart fallback), use it
-	if (_isChunked == true)
-		return (_bodyPos);
-
-	if (_useMultipartBoundary == true && _bodyComplete == true && _bodyPos > 0)
-		return (_bodyPos);
-
-	// Unchunked normal framing with Content-Length
-	return (body_start + _content_length);
+	return (_rawString.size() > _requestStart);
 }
@@ -8,6 +8,8 @@
 #include <string>
 #include <stdexcept>
 #include <cctype>
+#include "../HttpMethod.hpp"
+#include "../BodyInflater.hpp"
 
 
 # define RED "\033[31m"
@@ -19,40 +21,157 @@
 # define WHITE "\033[37m"
 # define RESET "\033[0m"
 
+# define BODY_RESERVE_MAX (32 * 1024 * 1024) // Content-Length reserved up front up to this
+# define REQUEST_KEEP_CAPACITY (64 * 1024) // a larger receive buffer is freed between requests
+# define PIPELINE_COMPACT (16 * 1024) // consumed bytes kept in front of pipelined requests
+# define REQUEST_LINE_MAX (8 * 1024) // defaults of large_client_header_buffers 4 8k:
+# define HEADER_BLOCK_MAX (32 * 1024) // longest request / header line, whole header block
+# define HEADER_COUNT_MAX 100 // header lines per request
+# define BODY_BUFFER_MAX (16 * 1024) // client_body_buffer_size default: larger bodies go to a temp file
+# define BODY_TEMP_PATH "/tmp" // client_body_temp_path default
+
+/*
+	Header names the server looks at, each with a fixed slot in the request.
+	Anything else is kept in a flat list and found by name.
+*/
+enum	HeaderId
+{
+	HDR_HOST,
+	HDR_CONTENT_LENGTH,
+	HDR_TRANSFER_ENCODING,
+	HDR_CONNECTION,
+	HDR_CONTENT_TYPE,
+	HDR_CONTENT_ENCODING,
+	HDR_EXPECT,
+	HDR_ACCEPT,
+	HDR_ACCEPT_ENCODING,
+	HDR_AUTHORIZATION,
+	HDR_COOKIE,
+	HDR_IF_MODIFIED_SINCE,
+	HDR_ORIGIN,
+	HDR_RANGE,
+	HDR_REFERER,
+	HDR_USER_AGENT,
+	HDR_KNOWN,           // number of known names
+	HDR_OTHER = HDR_KNOWN
+};
+
+HeaderId	lookupHeader(const char *name, size_t length);
+
+/*
+	Incremental HTTP/1.1 request parser.
+	feed() appends bytes and advances a state machine
+	(request line -> headers -> body / chunks -> done) from a scan cursor that
+	survives between calls, so bytes already consumed are never looked at again.
+	Malformed input puts it in an error state carrying the status code to answer with.
+	Limits are enforced while bytes arrive: an over-long request line (414), header
+	line, block or count (431), chunk size line (400) or trailer section (431) fails
+	before the rest is buffered, and once the headers are in the parser waits for
+	setBodyLimit(), so an announced Content-Length over the limit is refused (413)
+	before any of the body is read; a chunked body fails as soon as its running total
+	passes the limit.
+	Header fields are not copied out: each is an offset/length slice of _rawString,
+	and so is the body. A chunked body is compacted in place, each chunk's data moved
+	down to follow the previous one, so the body exists exactly once in memory.
+	Pipelined requests are parsed where they sit in the buffer: the next one starts
+	at the cursor, and the consumed prefix is only cut off once it is large.
+	A body over the buffer size is streamed to an unlinked temp file as it arrives and
+	leaves the receive buffer, so a connection holds about one read of it in memory;
+	once complete the file is mapped read-only and getBodyData() points into the map.
+	A gzip / deflate Content-Encoding body is inflated while it is framed, after the
+	chunk decoding; the limit and the spill threshold apply to the inflated length, and
+	the request then reads as if the body had been sent plain.
+*/
 class	HTTPRequest
 {
 	private:
+		enum ParseState
+		{
+			PARSE_REQUEST_LINE,
+			PARSE_HEADERS,
+			PARSE_HEADERS_DONE,  // waiting for setBodyLimit()
+			PARSE_BODY,          // Content-Length framing
+			PARSE_MULTIPART,     // no Content-Length: up to the closing boundary
+			PARSE_CHUNK_SIZE,
+			PARSE_CHUNK_DATA,
+			PARSE_CHUNK_TRAILER,
+			PARSE_DONE,
+			PARSE_ERROR
+		};
+
+		// name and value of one header line, as offsets into _rawString (value is trimmed)
+		struct HeaderField
+		{
+			size_t	name;
+			size_t	nameLen; // 0: not sent
+			size_t	value;
+			size_t	valueLen;
+		};
+
+		// unlinked temp file holding a spilled body, shared by copies of the request
+		struct BodyFile
+		{
+			int		fd;
+			int		refs;
+			char	*map; // the whole body, once it is complete
+			size_t	mapLength;
+		};
+
+		// inflate state of an encoded body, shared by copies of the request
+		struct BodyDecoder
+		{
+			BodyInflater	inflater;
+			int		refs;
+		};
+
 		int			_socketFD;
+		std::string	_localAddress; // address:port the client connected to, for vhost selection
+		int			_localPort;
 		std::string	_rawString;
-		std::string	_rawHeader;
-		std::string	_rawBody;
-		bool	_headerComplete;
-		bool	_bodyComplete;
 		bool	_connectionAlive;
 
+		/* Parser state */
+		ParseState	_state;
+		size_t	_requestStart; // where the current request begins in _rawString
+		size_t	_scan;        // first byte of _rawString not consumed yet
+		size_t	_searchFrom;  // a pending line / boundary search resumes here
+		size_t	_headerStart; // first header line, right after the request line
+		size_t	_headerEnd;   // the empty line that ends the header block
+		int		_errorStatus; // status to answer with once _state is PARSE_ERROR
+
+		/* Limits */
+		size_t	_lineMax;        // request line / header line length
+		size_t	_headerMax;      // request line + header block
+		size_t	_headerCountMax;
+		size_t	_headerCount;
+		size_t	_bodyMax;        // 0: unlimited
+		size_t	_bodyBufferMax;  // a larger body is spilled to a file in _tempPath
+		std::string	_tempPath;
+
 		/* Header */
-		std::map<std::string, std::string> _header;
+		HeaderField	_known[HDR_KNOWN];       // by HeaderId
+		std::vector<HeaderField>	_other; // every other name, in arrival order
 
-		/* Body */
-		std::vector<char> _body;
+		/* Body: _rawString[_bodyStart, _bodyStart + _bodyLength), or all of _bodyFile */
+		size_t	_bodyStart;
+		size_t	_bodyLength;
+		size_t	_received;    // framed body bytes taken so far (before inflating)
+		BodyFile	*_bodyFile;
+		BodyDecoder	*_decoder; // set while a Content-Encoding body is inflated
+		bool	_bodyDecoded;
 
 		/* Body - Chunked */
 		bool	_isChunked;
-		bool	_chunkedComplete;
-		size_t	_bodyPos; // cursor position to store where previous reading pos
 		size_t	_chunkSize;
-		void	skipHeader();
-		bool	readChunkSize();
-		bool	checkLastChunk();
-		bool	readChunkData();
+		size_t	_trailerSize; // trailer bytes read so far, held to _headerMax
 
 		/* Body - Unchunked */
 		size_t	_content_length;
 
 		/* Request Line */
 		std::string	_request_line;
-		size_t	_request_line_len;
 		std::string	_method;
+		HttpMethod	_methodId;
 		std::string	_path;
 		std::string	_query;
 		std::string	_version;
@@ -60,25 +179,47 @@ class	HTTPRequest
 		bool	_useMultipartBoundary;   // true when we should use boundary-terminated framing
 		std::string _boundary;               // boundary token without the leading "--"
 
-		void	extractRequestLine();
+		void	parse();
+		/* State machine steps: each returns false when it needs more bytes (or failed) */
+		bool	nextLine(size_t &start, size_t &length);
+		bool	parseRequestLine();
+		bool	parseHeaderLine();
+		bool	parseBody();
+		bool	parseMultipart();
+		bool	parseChunkSize();
+		bool	parseChunkData();
+		bool	parseChunkTrailer();
+		bool	finishBody();
+		bool	fail(int status);
+
+		/* Body - Spilled / Inflated */
+		bool	streamBody(size_t max, size_t &consumed);
+		bool	openBodyFile();
+		bool	writeBody(const char *data, size_t length);
+		bool	spill(size_t max);
+		bool	startDecoder();
+		bool	inflateBody(size_t max, size_t &consumed);
+		void	releaseDecoder();
+		bool	mapBodyFile();
+		void	releaseBodyFile();
+
 		void	processRequestLine(std::string &line);
 		void	trimBackslashR(std::string &line);
 		void	trimSpaces(std::string	&line);
 
 		/* Header */
-		void	extractHeader();
-		void	analyzeHeader();
-		void	checkContentLength();
+		void	clearHeaders();
+		const HeaderField	*findHeader(const std::string &name) const;
+		std::string	sliceString(size_t offset, size_t length) const;
+		bool	sliceContains(const HeaderField &field, const char *token) const;
+		bool	analyzeHeader();
+		bool	checkContentLength();
 		void	checkChunked();
 		void	processConnection();
-		bool	evaluateAlive(const std::string version, const bool hasConnection, const std::string connection);
+		bool	evaluateAlive(const std::string &version, const HeaderField &connection) const;
 		bool	hasMultipart() const;
 		bool	extractBoundary(const std::string &ctype, std::string &outBoundary) const;
 
-		/* Body */
-		void	processChunked();
-		void	processUnchunked();
-
 	public:
 		HTTPRequest();
 		HTTPRequest(int socketFD);
@@ -86,56 +227,53 @@ class	HTTPRequest
 		HTTPRequest(const HTTPRequest &other);
 		HTTPRequest	&operator=(const HTTPRequest &other);
 
+		void	feed(const char *data, size_t length);
 		void	feed(std::string &data);
 		void	resetForNextRequest();
-		size_t	endOfMessageOffset() const;
+		void	setHeaderLimits(size_t lineMax, size_t headerMax, size_t countMax); // kept across requests
+		void	setBodyBuffer(size_t size, const std::string &tempPath); // kept across requests
+		bool	awaitingBodyLimit() const; // headers are in, the body waits for setBodyLimit()
+		void	setBodyLimit(size_t limit, bool decode); // 0: unlimited; 413 when already exceeded
+		void	abandon(); // answered before the body was read: bytes still arriving are ignored
+		bool	hasPendingData() const; // bytes of a request not completed yet
 
 		/* Getters */
 		const std::string &getRawString() const;
-		const std::string &getRawHeader() const;
-		const std::string &getRawBody() const;
-		const std::map<std::string, std::string> &getHeaderMap() const;
-		const std::vector<char> &getBodyVector() const;
+		std::string getRawHeader() const;
+		const char *getBodyData() const; // valid until the next feed() or reset
+		size_t getBodySize() const;
+		int getBodyFile() const; // fd of the spilled body, -1 when it is in memory
+		bool isBodyDecoded() const; // inflated from its Content-Encoding
+		bool hasHeader(HeaderId id) const;
+		std::string getHeader(HeaderId id) const; // "" when not sent
+		std::string getHeader(const std::string &name) const; // any name, case-insensitive
+		bool headerContains(HeaderId id, const char *token) const; // case-insensitive, lowercase token
+		std::map<std::string, std::string> getHeaderMap() const; // lowercase names, built on each call
+		void printHeaders(std::ostream &out) const;
 		bool isHeaderComplete() const;
 		bool isBodyComplete() const;
+		bool hasError() const;
+		int getErrorStatus() const; // 400, 411, 413, 414, 415, 431, 500, 501 or 505 once hasError()
 		bool isConnectionAlive() const;
 		bool isChunked() const;
 		const std::string &getMethod() const;
+		HttpMethod getMethodId() const;
 		const std::string &getPath() const;
 		const std::string &getQueryString() const;
 		const std::string &getVersion() const;
 		const int &getSocketFD() const;
+		const std::string &getLocalAddress() const;
+		int getLocalPort() const;
 
 		/* Setters */
 		void setRawString(std::string &rawString);
-		void setRawHeader(const std::string &rawHeader);
-		void setRawBody(const std::string &rawBody);
 		void setConnectionAlive(const bool &connectionAlive);
-		void setHeaderMap(const std::map<std::string, std::string> &header);
-		void setBodyVector(const std::vector<char> &body);
 		void setMethod(const std::string &method);
 		void setPath(const std::string &path);
 		void setQueryString(const std::string &query);
 		void setVersion(const std::string &version);
 		void setSocketFD(const int &socketFD);
-
-		class EmptyRawString : public std::exception
-		{
-			public: 
-				const char *what() const throw ();
-		};
-
-		class EmptyRawHeader : public std::exception
-		{
-			public: 
-				const char *what() const throw ();
-		};
-
-		class ContentLengthConversionFailed : public std::exception
-		{
-			public:
-				const char *what() const throw ();
-		};
+		void setLocalAddress(const std::string &address, int port);
 
 		/* Utility */
 		std::string	connectionHeader(bool keep) const;
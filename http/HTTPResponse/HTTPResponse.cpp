@@ -131,6 +131,13 @@ const std::string &HTTPResponse::getRawResponse() const
 	return (this->_completeRawResponse);
 }
 
+// Hand the raw response over without copying it; this response is empty afterwards
+void	HTTPResponse::releaseRawResponse(std::string &out)
+{
+	out.swap(this->_completeRawResponse);
+	this->_completeRawResponse.clear();
+}
+
 int HTTPResponse::getStatusCode() const
 {
 	return (this->_statusCode);
@@ -71,6 +71,7 @@ class	HTTPResponse
 		const std::string	&getContent() const;
 		int					getSocketFD() const;
 		const std::string	&getRawResponse() const;
+		void				releaseRawResponse(std::string &out);
 		const std::string	&getStatusMessage() const;
 		int					getStatusCode() const;
 		int					getBodyLen() const;
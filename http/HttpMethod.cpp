@@ -0,0 +1,29 @@
+#include "HttpMethod.hpp"
+#include <cstring>
+
+static const char	*g_methodNames[METHOD_UNKNOWN + 1] =
+{
+	"GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH", ""
+};
+
+static const size_t	g_methodLengths[METHOD_UNKNOWN] = {3, 4, 4, 3, 6, 7, 7, 5, 5};
+
+/*
+	Lengths are compared first, so a known method costs one or two memcmps
+*/
+HttpMethod	parseMethod(const char *name, size_t length)
+{
+	for (int method = METHOD_GET; method < METHOD_UNKNOWN; ++method)
+	{
+		if (g_methodLengths[method] == length && std::memcmp(name, g_methodNames[method], length) == 0)
+			return (static_cast<HttpMethod>(method));
+	}
+	return (METHOD_UNKNOWN);
+}
+
+const char	*methodName(HttpMethod method)
+{
+	if (method < METHOD_GET || method > METHOD_UNKNOWN)
+		return ("");
+	return (g_methodNames[method]);
+}
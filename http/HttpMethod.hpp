@@ -0,0 +1,31 @@
+#ifndef HTTPMETHOD_HPP
+# define HTTPMETHOD_HPP
+
+#include <cstddef>
+
+/*
+	Request methods as small integers: the request line is parsed into one once,
+	and a location's allowed_methods become a bitmask of METHOD_BIT()s at config load,
+	so a method check is a single AND.
+*/
+enum	HttpMethod
+{
+	METHOD_GET,
+	METHOD_HEAD,
+	METHOD_POST,
+	METHOD_PUT,
+	METHOD_DELETE,
+	METHOD_CONNECT,
+	METHOD_OPTIONS,
+	METHOD_TRACE,
+	METHOD_PATCH,
+	METHOD_UNKNOWN     // a token we do not know, in no mask
+};
+
+# define METHOD_BIT(method) (1u << (method))
+
+// method names are case-sensitive (RFC 9110 §9.1)
+HttpMethod	parseMethod(const char *name, size_t length);
+const char	*methodName(HttpMethod method); // "" for METHOD_UNKNOWN
+
+#endif
@@ -0,0 +1,54 @@
+#include "PathCache.hpp"
+
+PathCache::PathCache(): _entries(PATH_CACHE_SLOTS)
+{
+	for (size_t i = 0; i < _entries.size(); ++i)
+		_entries[i].used = false;
+}
+
+// FNV-1a over the path, with the pointers folded in
+size_t	PathCache::slot(const ServerConfig *server, const Location *location, const std::string *base,
+	const std::string &path) const
+{
+	size_t	hash = 2166136261u;
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		hash ^= static_cast<unsigned char>(path[i]);
+		hash *= 16777619u;
+	}
+	hash ^= reinterpret_cast<size_t>(server) >> 4;
+	hash ^= reinterpret_cast<size_t>(location) >> 3;
+	hash ^= reinterpret_cast<size_t>(base) >> 5;
+	hash ^= hash >> 15;
+	return (hash & (PATH_CACHE_SLOTS - 1));
+}
+
+const std::string	*PathCache::find(const ServerConfig *server, const Location *location, const std::string *base,
+	const std::string &path) const
+{
+	if (path.size() > PATH_CACHE_MAX_PATH)
+		return (NULL);
+	const Entry	&entry = _entries[slot(server, location, base, path)];
+	if (entry.used && entry.server == server && entry.location == location && entry.base == base
+		&& entry.path == path)
+		return (&entry.resolved);
+	return (NULL);
+}
+
+const std::string	&PathCache::store(const ServerConfig *server, const Location *location, const std::string *base,
+	const std::string &path, const std::string &resolved)
+{
+	if (path.size() > PATH_CACHE_MAX_PATH)
+	{
+		_scratch = resolved;
+		return (_scratch);
+	}
+	Entry	&entry = _entries[slot(server, location, base, path)];
+	entry.server = server;
+	entry.location = location;
+	entry.base = base;
+	entry.path = path; // assign: reuses the replaced entry's capacity
+	entry.resolved = resolved;
+	entry.used = true;
+	return (entry.resolved);
+}
@@ -0,0 +1,52 @@
+#ifndef PATHCACHE_HPP
+# define PATHCACHE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+struct ServerConfig;
+struct Location;
+
+# define PATH_CACHE_SLOTS 256 // entries, a power of two
+# define PATH_CACHE_MAX_PATH 256 // longer request paths are resolved every time
+
+/*
+	Filesystem path a request resolves to, by (server, location, base directory,
+	normalized path); the base is the root for static files, upload_path for uploads.
+	Direct-mapped: a path hashes to one slot and a newer path simply replaces the entry
+	there, so a hot URL costs a hash and a compare instead of root selection and string
+	building. The config is read-only while serving, so its pointers are stable keys.
+	One cache per event loop (Server), nothing is shared between threads.
+*/
+class	PathCache
+{
+	private:
+		struct Entry
+		{
+			const ServerConfig	*server;
+			const Location		*location;
+			const std::string	*base;
+			std::string	path;
+			std::string	resolved;
+			bool	used;
+		};
+
+		std::vector<Entry>	_entries;
+		std::string	_scratch; // result of a path too long to be cached
+
+		size_t	slot(const ServerConfig *server, const Location *location, const std::string *base,
+			const std::string &path) const;
+
+	public:
+		PathCache();
+
+		// NULL on a miss
+		const std::string	*find(const ServerConfig *server, const Location *location, const std::string *base,
+			const std::string &path) const;
+		// the stored copy, valid until the next store()
+		const std::string	&store(const ServerConfig *server, const Location *location, const std::string *base,
+			const std::string &path, const std::string &resolved);
+};
+
+#endif
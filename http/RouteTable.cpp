@@ -0,0 +1,109 @@
+#include "RouteTable.hpp"
+
+RouteTable::RouteTable()
+{
+	this->addNode("", -1);
+}
+
+int	RouteTable::addNode(const std::string &label, int value)
+{
+	Node	node;
+	node.label = label;
+	node.value = value;
+	this->_nodes.push_back(node);
+	return (static_cast<int>(this->_nodes.size()) - 1);
+}
+
+/*
+	Binary search over the children's first bytes: a node with hundreds of siblings
+	(every location directly under "/") costs a handful of compares, not hundreds
+*/
+int	RouteTable::findChild(int node, unsigned char first) const
+{
+	const std::vector<int>	&children = this->_nodes[node].children;
+	size_t	low = 0;
+	size_t	high = children.size();
+	while (low < high)
+	{
+		size_t	mid = (low + high) / 2;
+		unsigned char	c = static_cast<unsigned char>(this->_nodes[children[mid]].label[0]);
+		if (c == first)
+			return (children[mid]);
+		if (c < first)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return (-1);
+}
+
+void	RouteTable::attach(int parent, int child)
+{
+	unsigned char	first = static_cast<unsigned char>(this->_nodes[child].label[0]);
+	std::vector<int>	&children = this->_nodes[parent].children;
+	size_t	i = 0;
+	while (i < children.size() && static_cast<unsigned char>(this->_nodes[children[i]].label[0]) < first)
+		++i;
+	children.insert(children.begin() + i, child);
+}
+
+void	RouteTable::add(const std::string &prefix, int value)
+{
+	if (prefix.empty())
+		return; // never the longest match of anything
+	int	node = 0;
+	size_t	pos = 0;
+	while (pos < prefix.size())
+	{
+		int	child = this->findChild(node, static_cast<unsigned char>(prefix[pos]));
+		if (child < 0)
+		{
+			this->attach(node, this->addNode(prefix.substr(pos), value));
+			return;
+		}
+		// common length of the edge and the rest of the prefix, at least its first byte
+		const std::string	label = this->_nodes[child].label;
+		size_t	common = 1;
+		while (common < label.size() && pos + common < prefix.size() && label[common] == prefix[pos + common])
+			++common;
+		if (common < label.size())
+		{
+			// the prefix ends or branches inside the edge: split it at common
+			int	middle = this->addNode(label.substr(0, common), -1);
+			this->_nodes[child].label = label.substr(common);
+			std::vector<int>	&siblings = this->_nodes[node].children;
+			for (size_t i = 0; i < siblings.size(); ++i)
+			{
+				if (siblings[i] == child)
+					siblings[i] = middle; // same first byte, the order holds
+			}
+			this->_nodes[middle].children.push_back(child);
+			child = middle;
+		}
+		node = child;
+		pos += common;
+	}
+	if (this->_nodes[node].value < 0)
+		this->_nodes[node].value = value;
+}
+
+int	RouteTable::match(const std::string &path) const
+{
+	int	best = -1;
+	int	node = 0;
+	size_t	pos = 0;
+	while (pos < path.size())
+	{
+		int	child = this->findChild(node, static_cast<unsigned char>(path[pos]));
+		if (child < 0)
+			break;
+		const std::string	&label = this->_nodes[child].label;
+		if (path.compare(pos, label.size(), label) != 0)
+			break;
+		pos += label.size();
+		node = child;
+		if (this->_nodes[node].value >= 0)
+			best = this->_nodes[node].value;
+	}
+	return (best);
+}
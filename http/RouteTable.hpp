@@ -0,0 +1,40 @@
+#ifndef ROUTETABLE_HPP
+# define ROUTETABLE_HPP
+
+#include <string>
+#include <vector>
+
+/*
+	A server's location prefixes compiled into a radix trie at startup.
+	match() walks the request path once, edge by edge, and keeps the last location it
+	passed: the longest prefix, the same answer as comparing the path with every
+	location but without looking at the ones that cannot match. Values are location
+	indexes, not pointers, so the table stays valid when its ServerConfig is copied.
+	Read-only once built, so worker threads share it without locking.
+*/
+class	RouteTable
+{
+	private:
+		struct Node
+		{
+			std::string	label;    // bytes on the edge into this node
+			int		value;        // location ending here, -1: none
+			std::vector<int>	children; // node indexes, ordered by the first byte of their label
+		};
+
+		std::vector<Node>	_nodes; // [0] is the root, its label is empty
+
+		int	findChild(int node, unsigned char first) const; // -1: no edge starts with first
+		int	addNode(const std::string &label, int value);
+		void	attach(int parent, int child);
+
+	public:
+		RouteTable();
+
+		// a prefix that is already in keeps its first value, like the first of two equal locations
+		void	add(const std::string &prefix, int value);
+		// value of the longest non-empty prefix of path, -1 when none matches
+		int	match(const std::string &path) const;
+};
+
+#endif
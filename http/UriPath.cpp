@@ -0,0 +1,79 @@
+#include "UriPath.hpp"
+
+static int	hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return (c - '0');
+	c = static_cast<char>(c | 0x20);
+	if (c >= 'a' && c <= 'f')
+		return (c - 'a' + 10);
+	return (-1);
+}
+
+/*
+	The output is kept as "[/]seg/seg/" plus the segment being written, which starts
+	at segment. When a segment ends, "." is dropped, ".." drops it and the one before,
+	and an empty one (a repeated '/') is not written at all.
+*/
+bool	normalizeUriPath(char *path, size_t &length)
+{
+	const size_t	base = (length > 0 && path[0] == '/') ? 1 : 0; // the root slash stays
+	size_t	read = base;
+	size_t	write = base;
+	size_t	segment = base;
+	while (true)
+	{
+		bool	end = read >= length;
+		char	c = '/';
+		if (!end)
+		{
+			c = path[read++];
+			if (c == '%')
+			{
+				if (length - read < 2)
+					return (false);
+				int	high = hexValue(path[read]);
+				int	low = hexValue(path[read + 1]);
+				if (high < 0 || low < 0 || (high == 0 && low == 0))
+					return (false);
+				c = static_cast<char>(high * 16 + low);
+				read += 2;
+			}
+			if (c != '/')
+			{
+				path[write++] = c;
+				continue;
+			}
+		}
+		size_t	segmentLength = write - segment;
+		if (segmentLength == 1 && path[segment] == '.')
+			write = segment;
+		else if (segmentLength == 2 && path[segment] == '.' && path[segment + 1] == '.')
+		{
+			if (segment == base)
+				return (false); // above the root
+			// back over the previous segment, up to the slash in front of it
+			write = segment - 1;
+			while (write > base && path[write - 1] != '/')
+				--write;
+		}
+		else if (segmentLength > 0 && !end)
+			path[write++] = '/';
+		segment = write;
+		if (end)
+			break;
+	}
+	length = write;
+	return (true);
+}
+
+bool	normalizeUriPath(std::string &path)
+{
+	if (path.empty())
+		return (true);
+	size_t	length = path.size();
+	if (!normalizeUriPath(&path[0], length))
+		return (false);
+	path.resize(length);
+	return (true);
+}
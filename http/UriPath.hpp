@@ -0,0 +1,20 @@
+#ifndef URIPATH_HPP
+# define URIPATH_HPP
+
+#include <string>
+#include <cstddef>
+
+/*
+	Request paths are decoded and normalized once, in the request-line parser, so every
+	consumer (routing, static files, uploads, DELETE, CGI) sees the same canonical path:
+	percent-escapes decoded, "//" merged, "." and ".." segments resolved (RFC 3986 §5.2.4).
+	A decoded "%2F" separates segments like '/', so an encoded "..%2F" cannot slip past.
+	The result never leaves its root: a ".." above it fails, so root + path stays inside root.
+	One pass over the input, written in place (the output is never longer), nothing allocated.
+*/
+
+// false on a malformed or NUL escape, or a ".." above the start of the path
+bool	normalizeUriPath(char *path, size_t &length);
+bool	normalizeUriPath(std::string &path);
+
+#endif
@@ -1,4 +1,9 @@
 #include "http_cgi.hpp"
+#include "ByteScan.hpp"
+#include "PathCache.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
 
 static void stripCgiStatusHeader(std::string& headersAndBody)
 {
@@ -39,7 +44,7 @@ static void sendError(int code, const std::string& message, int socketFD, const
 		std::string body = oss.str();
 		std::string full = "Content-Type: text/html\r\nConnection: close\r\n\r\n" + body;
 		HTTPResponse resp(message, code, full, socketFD);
-		srv.queueResponse(socketFD, resp.getRawResponse());
+		srv.queueResponse(socketFD, resp);
 		return;
 	}
 	
@@ -50,28 +55,31 @@ static void sendError(int code, const std::string& message, int socketFD, const
 	}
 	
 	ErrorResponse errorResp(code, message, *sc, extraHeaders, socketFD);
-	srv.queueResponse(socketFD, errorResp.getRawResponse());
+	srv.queueResponse(socketFD, errorResp);
 }
 /* --------------------------------------------------------------------------------------------------------------------------------*/
 
 // CGI call function
-CGIResult runCGI(const HTTPRequest& request, const std::string& script_path, const std::map<std::string, std::string>& cgi_extensions, const std::string& working_directory, const std::string& server_name, int server_port)
+CGIResult runCGI(const HTTPRequest& request, const std::string& script_path, const std::string& executor, const std::string& working_directory, const std::string& server_name, int server_port)
 {
 	CGIHandler cgi_handler;
-	return cgi_handler.executeCGI(request, script_path, cgi_extensions, working_directory, server_name, server_port);
+	return cgi_handler.executeCGI(request, script_path, executor, working_directory, server_name, server_port);
 }
 
-// read static files structure
-std::string serveFile(const std::string& filePath)
+// open a static file for sending; -1 if it is missing, not a regular file or empty
+int openStaticFile(const std::string& filePath, size_t& size)
 {
-	std::ifstream file(filePath.c_str());
-	if (!file.is_open()) {
-		return ""; // File not found
+	int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1; // File not found
 	}
-	
-	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-	file.close();
-	return content;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return -1;
+	}
+	size = static_cast<size_t>(st.st_size);
+	return fd;
 }
 
 // Directory listing autoindex
@@ -111,104 +119,113 @@ std::string generateDirectoryListing(const std::string& dirPath)
 }
 
 
+// How well a server's listen directives cover the address a client connected to:
+// 3 same address or unix socket (or only the port is known), 2 wildcard of the same family,
+// 1 dual-stack [::] serving an IPv4 client, 0 not at all
+static int listenMatch(const ServerConfig& server, const std::string& ip, int port) {
+	bool ipv6 = ip.find(':') != std::string::npos;
+	int best = 0;
+	for (size_t i = 0; i < server.listens.size(); ++i) {
+		const ListenAddress& listen = server.listens[i];
+		if (listen.isUnix()) {
+			if (ip == listen.name())
+				return 3;
+			continue;
+		}
+		if (listen.port != port)
+			continue;
+		if (ip.empty() || listen.ip == ip)
+			return 3;
+		if (listen.isWildcard() && listen.isIPv6() == ipv6)
+			best = std::max(best, 2);
+		else if (listen.ip == "::" && !ipv6)
+			best = std::max(best, 1);
+	}
+	return best;
+}
+
+/*
+	Virtual host selection, like nginx: the servers listening on the address the client
+	connected to (most specific listen first) are the candidates, the Host header picks
+	one of them by server_name, and the first candidate is the default.
+*/
 const ServerConfig* findServerConfig(const HTTPRequest& request, const std::vector<ServerConfig>& servers) {
-	const std::map<std::string, std::string>& headers = request.getHeaderMap();
-	std::map<std::string, std::string>::const_iterator host_it = headers.find("host");
-	
-	if (host_it == headers.end()) {
-		// No Host header, return first server as fallback
-		return servers.empty() ? NULL : &servers[0];
-	}
-	
-	std::string host = host_it->second;  // "localhost:8081" or "example.com:8080"
 	std::string hostname;
-	std::string port_str;
-	int port;
-	
-	// Parse hostname and port from Host header
-	size_t colon_pos = host.find(':');
-	if (colon_pos != std::string::npos) {
-		hostname = host.substr(0, colon_pos);
-		port_str = host.substr(colon_pos + 1);
-		port = atoi(port_str.c_str());
-	} else {
-		// No port specified, assume default port 80
-		hostname = host;
-		port = 80;
-	}
-	
-	// First pass: Exact Match (Hostname + Port)
-	for (size_t i = 0; i < servers.size(); ++i) {
-		if (servers[i].port == port) {
-			// Check if this server has the requested hostname
-			for (size_t j = 0; j < servers[i].server_names.size(); ++j) {
-				if (servers[i].server_names[j] == hostname) {
-					return &servers[i];
-				}
-			}
+	int port = request.getLocalPort(); // 0 for unix sockets
+	std::string ip = request.getLocalAddress();
+	bool local_known = !ip.empty();
+	
+	if (request.hasHeader(HDR_HOST)) {
+		std::string host = request.getHeader(HDR_HOST);  // "localhost:8081", "example.com" or "[::1]:8080"
+		size_t colon_pos = host.find(':');
+		if (!host.empty() && host[0] == '[') {
+			size_t close = host.find(']');
+			hostname = host.substr(0, close == std::string::npos ? close : close + 1);
+			colon_pos = close == std::string::npos ? close : host.find(':', close);
+		} else {
+			hostname = host.substr(0, colon_pos);
+		}
+		// No local address (not accepted by us): fall back to the port in the Host header
+		if (!local_known) {
+			port = colon_pos != std::string::npos ? atoi(host.c_str() + colon_pos + 1) : 80;
+			ip.clear();
 		}
+	} else if (!local_known) {
+		// No Host header, return first server as fallback
+		return servers.empty() ? NULL : &servers[0];
 	}
 	
-	// Second pass: port match only. If no exact hostname match, find first server on the same port
-	//Acts as default server for that port
+	const ServerConfig* match = NULL;
+	bool named = false;
+	int level = 0;
 	for (size_t i = 0; i < servers.size(); ++i) {
-		if (servers[i].port == port) {
-			return &servers[i];
+		int m = listenMatch(servers[i], ip, port);
+		if (m == 0 || m < level)
+			continue;
+		bool has_name = std::find(servers[i].server_names.begin(), servers[i].server_names.end(),
+			hostname) != servers[i].server_names.end();
+		// a more specific listen wins; on the same one, the first with a matching name
+		if (m > level) {
+			level = m;
+			match = &servers[i];
+			named = has_name;
+		} else if (has_name && !named) {
+			match = &servers[i];
+			named = true;
 		}
 	}
-	
-	return NULL; // No matching server found
+	return match; // NULL: no server listens there
 }
 
 
-// Check whether CGI is enabled for a specific path by finding the most specific location match (from config file)
-bool isCGIEnabled(const std::string& path, const ServerConfig* server_config) {
-	const Location* best_match = getMatchingLocation(path, server_config);
-	
-	if (best_match) {
-		bool has_cgi = !best_match->cgi_extensions.empty();
-		std::cout << "CGI Status - Path: " << path << " | CGI Enabled: " << (has_cgi ? "YES" : "NO") << std::endl;
-		return has_cgi;
-	}
-	
-	return false;
-}
-
-// Helper function to get CGI extensions for a path
-std::map<std::string, std::string> getCGIExtensions(const std::string& path, const ServerConfig* server_config) {
-	std::map<std::string, std::string> cgi_extensions;
-	
-	const Location* best_match = getMatchingLocation(path, server_config);
-	
-	if (best_match) {
-		cgi_extensions = best_match->cgi_extensions;
-	}
-	
-	return cgi_extensions;
-}
 
 
-
-std::string parseMultipartData(const std::string& body, const std::string& boundary, std::string& filename) {
+/*
+	Finds the first file part of a multipart body. Its content is reported as an
+	offset and length into body, nothing is copied. false if there is no usable part.
+*/
+bool parseMultipartData(const char* body, size_t body_size, const std::string& boundary, std::string& filename,
+	size_t& content_start, size_t& content_length) {
 	if (boundary.empty()) {
-		return "";
+		return false;
 	}
+	const char* end = body + body_size;
 	
 	// Find the boundary in the body
 	std::string full_boundary = "--" + boundary;
-	size_t boundary_pos = body.find(full_boundary);
-	if (boundary_pos == std::string::npos) {
-		return "";
+	const char* boundary_pos = scanBytes(body, end, full_boundary.data(), full_boundary.size());
+	if (boundary_pos == end) {
+		return false;
 	}
 	
 	// Finds where headers end and file content begins
-	size_t header_end = body.find("\r\n\r\n", boundary_pos);
-	if (header_end == std::string::npos) {
-		return "";
+	const char* header_end = scanBytes(boundary_pos, end, "\r\n\r\n", 4);
+	if (header_end == end) {
+		return false;
 	}
 	
 	// Extract header between boundary and \r\n\r\n
-	std::string headers = body.substr(boundary_pos, header_end - boundary_pos);
+	std::string headers(boundary_pos, header_end);
 	// extract filename from headers
 	size_t filename_pos = headers.find("filename=\"");
 	if (filename_pos != std::string::npos) {
@@ -219,27 +236,75 @@ std::string parseMultipartData(const std::string& body, const std::string& bound
 		}
 	}
 	
-	// Extract file content (after headers, before next boundary)
-	size_t content_start = header_end + 4; // Skip \r\n\r\n
-	size_t next_boundary = body.find(full_boundary, content_start);
-	if (next_boundary == std::string::npos) {
-		// No next boundary, take until end
-		return body.substr(content_start);
+	// File content: after headers, before next boundary (or until the end)
+	const char* content = header_end + 4; // Skip \r\n\r\n
+	const char* next_boundary = scanBytes(content, end, full_boundary.data(), full_boundary.size());
+	size_t length = next_boundary - content;
+	// the \r\n before the next boundary belongs to the delimiter
+	if (next_boundary != end && length >= 2 && content[length - 2] == '\r' && content[length - 1] == '\n') {
+		length -= 2;
 	}
-	
-	// Clean up and Removes trailing \r\n from file content
-	std::string content = body.substr(content_start, next_boundary - content_start);
-	if (content.length() >= 2 && content.substr(content.length() - 2) == "\r\n") {
-		content = content.substr(0, content.length() - 2);
-	}
-	
-	return content;
+	content_start = content - body;
+	content_length = length;
+	return true;
 }
  
+/*
+	Writes [offset, offset + length) of the request body to path. A body spilled to a
+	temp file is copied file to file inside the kernel, so a large upload never passes
+	through our memory; otherwise (or where copy_file_range is refused) it is written
+	from the body view.
+*/
+static bool writeBodyRange(const std::string& path, const HTTPRequest& request, size_t offset, size_t length) {
+	int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0) {
+		return false;
+	}
+	size_t done = 0;
+#ifdef __linux__
+	int in = request.getBodyFile();
+	while (in >= 0 && done < length) {
+		loff_t from = static_cast<loff_t>(offset + done);
+		ssize_t n = copy_file_range(in, &from, out, NULL, length - done, 0);
+		if (n <= 0) {
+			break; // EXDEV / ENOSYS on older kernels: the rest goes through write()
+		}
+		done += static_cast<size_t>(n);
+	}
+#endif
+	const char* data = request.getBodyData() + offset;
+	while (done < length) {
+		ssize_t n = write(out, data + done, length - done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			close(out);
+			return false;
+		}
+		done += static_cast<size_t>(n);
+	}
+	return close(out) == 0;
+}
+
+/*
+	The client picks the stored file's name: only its last component is kept (browsers
+	may send "C:\dir\name"), and a name that would leave the upload directory or
+	cut the path short is refused.
+*/
+static bool uploadFileName(std::string& filename) {
+	size_t last_sep = filename.find_last_of("/\\");
+	if (last_sep != std::string::npos) {
+		filename.erase(0, last_sep + 1);
+	}
+	return filename != "." && filename != ".." && filename.find('\0') == std::string::npos;
+}
+
 bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path, int socketFD, const ServerConfig* server_config, Server& srv) {
-	// Gets the HTTP request body (contains the file data)
-	std::string body = request.getRawBody();
-	if (body.empty()) {
+	// The HTTP request body (contains the file data), a view into the request buffer
+	const char* body = request.getBodyData();
+	size_t body_size = request.getBodySize();
+	if (body_size == 0) {
 		sendError(400, "Bad Request", socketFD, server_config, &request, srv);
 		return false;
 	}
@@ -253,22 +318,18 @@ bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path
 	}
 	
 	// Check if it's multipart/form-data
-	std::string content_type = "";
-	std::map<std::string, std::string> headers = request.getHeaderMap();
-	std::map<std::string, std::string>::const_iterator ct_it = headers.find("content-type");
-	if (ct_it != headers.end()) {
-		content_type = ct_it->second;
-	}
+	std::string content_type = request.getHeader(HDR_CONTENT_TYPE);
 	
 	std::string filename = "";
-	std::string file_content = "";
+	size_t file_offset = 0; // into the body
+	size_t file_size = 0;
 	
 	if (content_type.find("multipart/form-data") != std::string::npos) {
 		// Parse multipart data
 		size_t boundary_pos = content_type.find("boundary=");
 		if (boundary_pos != std::string::npos) {
 			std::string boundary = content_type.substr(boundary_pos + 9);
-			file_content = parseMultipartData(body, boundary, filename);
+			parseMultipartData(body, body_size, boundary, filename, file_offset, file_size);
 		}
 	} else {
 		// direct upload without html
@@ -277,7 +338,7 @@ bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path
 		request.getPath() = "/upload/myfile.jpg"
 		filename = "myfile.jpg" (after last /)
 		*/
-		file_content = body;
+		file_size = body_size;
 		// Extract filename from path
 		filename = request.getPath();
 		size_t last_slash = filename.find_last_of('/');
@@ -286,6 +347,10 @@ bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path
 		}
 	}
 	
+	if (!uploadFileName(filename)) {
+		sendError(400, "Bad Request", socketFD, server_config, &request, srv);
+		return false;
+	}
 	if (filename.empty()) {
 		// Generate a unique filename
 		std::ostringstream oss;
@@ -293,7 +358,7 @@ bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path
 		filename = oss.str();
 	}
 	
-	if (file_content.empty()) {
+	if (file_size == 0) {
 		sendError(400, "Bad Request", socketFD, server_config, &request, srv);
 		return false;
 	}
@@ -303,38 +368,87 @@ bool handleFileUpload(const HTTPRequest& request, const std::string& upload_path
 	/*
 	Open file for binary writing
 	Check if opened successfully (disk space, permissions, etc.)
-	Write raw bytes from file_content
+	Write the file's bytes of the body
 	Close file
 	*/
-	std::ofstream file(file_path.c_str(), std::ios::binary);
-	if (!file.is_open()) {
+	if (!writeBodyRange(file_path, request, file_offset, file_size)) {
 		sendError(500, "Internal Server Error", socketFD, server_config, &request, srv);
 		return false;
 	}
 	
-	file.write(file_content.c_str(), file_content.size());
-	file.close();
-	
 	// Send success response
 	std::string response_content = "Content-Type: text/plain\r\n"
 								 + request.connectionHeader(request.isConnectionAlive()) + "\r\n"
 								 + "File uploaded successfully: " + filename;
 	HTTPResponse response("Created", 201, response_content, socketFD);
-	srv.queueResponse(socketFD, response.getRawResponse());
+	srv.queueResponse(socketFD, response);
 	return true;
 }
 
-// Helper function to handle file deletion 
-bool handleFileDeletion(const HTTPRequest& request, const std::string& server_root, int socketFD, const ServerConfig* server_config, Server& srv) {
-	std::string path = request.getPath();
-	
-	// load upload directory, use the upload path instead of server root
-	std::string file_path;
-	if (path.find("/upload/") == 0) {
-		file_path = "./pages/upload" + path.substr(7); // Remove "/upload" prefix
+/*
+	Filesystem path of a static request, from the cache when this (server, location, path)
+	was seen before. The path is already normalized by the parser, so root + path stays
+	under root. "/" maps to the location index, or to the root itself for autoindex.
+*/
+static const std::string& resolveStaticPath(const RouteContext& route, const std::string& path, PathCache& cache)
+{
+	const Location* matching_location = route.location;
+	const std::string* cached = cache.find(route.server, matching_location, route.root, path);
+	if (cached)
+		return *cached;
+
+	const std::string& server_root = *route.root;
+	std::string server_root_with_slash = server_root;
+	if (!server_root_with_slash.empty() && server_root_with_slash[server_root_with_slash.size() - 1] != '/')
+		server_root_with_slash += "/";
+
+	// Check if location has custom index → use it
+	// Otherwise → default to "index.html"
+	std::string filePath;
+	if (path == "/" || path.empty()) {
+		if (matching_location && matching_location->autoindex) {
+			filePath = server_root_with_slash;
+		} else {
+			std::string indexName = (matching_location && !matching_location->index.empty())
+								? matching_location->index : "index.html";
+			filePath = server_root_with_slash + indexName;
+		}
 	} else {
-		file_path = server_root + path;
+		filePath = server_root + path; // filePath = "./pages/www/about.html"
 	}
+	return cache.store(route.server, matching_location, route.root, path, filePath);
+}
+
+/*
+	File under the location's upload_path that a path names: what follows the location
+	prefix, where handleFileUpload stored it. The path is normalized by the parser, so
+	it cannot climb out of upload_path. Cached like static paths, upload_path as the base.
+*/
+static const std::string& resolveUploadPath(const RouteContext& route, const std::string& path, PathCache& cache)
+{
+	const Location* location = route.location;
+	const std::string* base = &location->upload_path;
+	const std::string* cached = cache.find(route.server, location, base, path);
+	if (cached)
+		return *cached;
+
+	std::string rest = path.size() > location->path.size() ? path.substr(location->path.size()) : "";
+	std::string filePath = location->upload_path;
+	if (!rest.empty() && rest[0] != '/' && (filePath.empty() || filePath[filePath.size() - 1] != '/'))
+		filePath += "/";
+	filePath += rest;
+	return cache.store(route.server, location, base, path, filePath);
+}
+
+// Helper function to handle file deletion 
+bool handleFileDeletion(const HTTPRequest& request, const RouteContext& route, int socketFD, Server& srv) {
+	const ServerConfig* server_config = route.server;
+	const Location* location = route.location;
+	
+	// an upload location deletes from its upload_path, anywhere else the static file goes
+	const std::string& file_path = (location && !location->upload_path.empty())
+		? resolveUploadPath(route, request.getPath(), srv.pathCache())
+		: resolveStaticPath(route, request.getPath(), srv.pathCache());
 	
 	// Check if file exists
 	if (access(file_path.c_str(), F_OK) != 0) {
@@ -351,90 +465,58 @@ bool handleFileDeletion(const HTTPRequest& request, const std::string& server_ro
 	// Send success response (204 No Content)
 	std::string response_content = request.connectionHeader(request.isConnectionAlive()) + "\r\n";
 	HTTPResponse response("No Content", 204, response_content, socketFD);
-	srv.queueResponse(socketFD, response.getRawResponse());
+	srv.queueResponse(socketFD, response);
 	return true;
 }
 
 // Main function to processes incoming HTTP requests and decides whether to serve static files, execute CGI scripts
-void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std::vector<ServerConfig>& servers, Server& srv) 
+void handleRequestProcessing(const HTTPRequest& request, const RouteContext& route, int socketFD, Server& srv) 
 {
 	std::string path = request.getPath();
 
-	// Server selection by Host:port
-	const ServerConfig* server_config = findServerConfig(request, servers);
-
-	// Pick the most specific location once
-	const Location* matching_location = getMatchingLocation(path, server_config);
-
-	// Decide CGI vs Static
-	bool cgi_enabled = isCGIEnabled(path, server_config);
-	if (cgi_enabled) {
-		std::map<std::string, std::string> cgi_extensions = getCGIExtensions(path, server_config);
-		CGIHandler cgi_handler;
-		if (cgi_handler.needsCGI(path, cgi_extensions)) {
-			std::string script_path = path;
-			std::string working_directory = "./";
-			if (path.find("/cgi_bin/") == 0) {
-				script_path = "./cgi_bin" + path.substr(8);
-				working_directory = "./";
-			}
+	// Server and location were resolved once, when the headers came in
+	const ServerConfig* server_config = route.server;
+	const Location* matching_location = route.location;
 
-			// Execute CGI
-			std::cout << "Executing CGI Script: " << script_path << std::endl;
-			
-			// Extract server name from Host header
-			std::string server_name = "localhost"; // default
-			const std::map<std::string, std::string>& headers = request.getHeaderMap(); //Gets all HTTP headers from the request
-			std::map<std::string, std::string>::const_iterator host_it = headers.find("host"); // Searches for the "host" header
-			
-			//If Host header is found, process it
-			//If not found, keep default "localhost"
-			if (host_it != headers.end()) {
-				std::string host = host_it->second;
-				size_t colon_pos = host.find(':');
-				if (colon_pos != std::string::npos) {
-					server_name = host.substr(0, colon_pos);
-				} else {
-					server_name = host;
-				}
+	// Decide CGI vs Static: the location maps the path's extension to an interpreter
+	if (route.cgi_executor) {
+		std::string script_path = path;
+		std::string working_directory = "./";
+		if (path.find("/cgi_bin/") == 0) {
+			script_path = "./cgi_bin" + path.substr(8);
+			working_directory = "./";
+		}
+
+		// Execute CGI
+		std::cout << "Executing CGI Script: " << script_path << std::endl;
+		
+		// Extract server name from Host header
+		std::string server_name = "localhost"; // default
+		//If Host header is found, process it
+		//If not found, keep default "localhost"
+		if (request.hasHeader(HDR_HOST)) {
+			std::string host = request.getHeader(HDR_HOST);
+			size_t colon_pos = host.find(':');
+			if (colon_pos != std::string::npos) {
+				server_name = host.substr(0, colon_pos);
+			} else {
+				server_name = host;
 			}
-			
-			CGIResult cgi_result = runCGI(request, script_path, cgi_extensions, working_directory, server_name, server_config->port);
-			std::string cgiPayload = cgi_result.content;
-			stripCgiStatusHeader(cgiPayload);
-			HTTPResponse response(cgi_result.status_message, cgi_result.status_code, cgiPayload, socketFD);
-			std::cout << "Queue CGI Response\n";
-			// Add to server queue
-			srv.queueResponse(socketFD, response.getRawResponse()); 
-			return;
 		}
 		
+		CGIResult cgi_result = runCGI(request, script_path, *route.cgi_executor, working_directory, server_name, server_config->port);
+		std::string cgiPayload = cgi_result.content;
+		stripCgiStatusHeader(cgiPayload);
+		HTTPResponse response(cgi_result.status_message, cgi_result.status_code, cgiPayload, socketFD);
+		std::cout << "Queue CGI Response\n";
+		// Add to server queue
+		srv.queueResponse(socketFD, response); 
+		return;
 	}
 
 	// Static file handle
-	std::string server_root = server_config ? server_config->root : "pages/www";  
-	if (matching_location && !matching_location->root.empty())
-		server_root = matching_location->root;
-
 	bool location_autoindex = matching_location && matching_location->autoindex;
-	std::string server_root_with_slash = server_root;
-	if (!server_root_with_slash.empty() && server_root_with_slash[server_root_with_slash.size() - 1] != '/')
-		server_root_with_slash += "/";
-
-	// Check if location has custom index → use it
-	// Otherwise → default to "index.html"
-	std::string filePath;                                                         
-	if (path == "/" || path.empty()) {
-		if (location_autoindex) {
-			filePath = server_root_with_slash;
-		} else {
-			std::string indexName = (matching_location && !matching_location->index.empty())
-								? matching_location->index : "index.html";
-			filePath = server_root_with_slash + indexName;
-		}
-	} else {
-		filePath = server_root + path; // filePath = "./pages/www/about.html"
-	}
+	const std::string &filePath = resolveStaticPath(route, path, srv.pathCache());
 
 	// Check if the method is allowed for this location
 	if (!methodAllowed(request, matching_location)) {
@@ -447,7 +529,7 @@ void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std
 	Has upload_path → Handle file upload
 	No upload_path → 400 Bad Request error
 	*/
-	if (request.getMethod() == "POST") {
+	if (request.getMethodId() == METHOD_POST) {
 		if (matching_location && !matching_location->upload_path.empty()) {
 			handleFileUpload(request, matching_location->upload_path, socketFD, server_config, srv);
 			return;
@@ -458,14 +540,14 @@ void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std
 	}
 
 	// Handle DELETE requests (file deletion)
-	if (request.getMethod() == "DELETE") {
-		handleFileDeletion(request, server_root, socketFD, server_config, srv);
+	if (request.getMethodId() == METHOD_DELETE) {
+		handleFileDeletion(request, route, socketFD, srv);
 		return;
 	}
 
 	// Auto index directory listing
 	// filePath ends with / (indicates directory)
-	if ((request.getMethod() == "GET" ) && !filePath.empty() && filePath[filePath.length() - 1] == '/') {
+	if ((request.getMethodId() == METHOD_GET) && !filePath.empty() && filePath[filePath.length() - 1] == '/') {
 		bool autoindex_enabled = location_autoindex;
 		if (autoindex_enabled) {
 			std::string dirListing = generateDirectoryListing(filePath);
@@ -473,16 +555,17 @@ void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std
 										+ request.connectionHeader(request.isConnectionAlive()) + "\r\n"
 										+ dirListing;
 			HTTPResponse response("OK", 200, responseContent, socketFD);
-			srv.queueResponse(socketFD, response.getRawResponse()); 
+			srv.queueResponse(socketFD, response); 
 		}
 		else
 			sendError(403, "Forbidden", socketFD, server_config, &request, srv);     
 		return;
 	}
 
-	// Read file (serveFile()) → Get file content
-	std::string content = serveFile(filePath);
-	if (content.empty()) {
+	// Open file (openStaticFile()) → the body is sent straight from it
+	size_t fileSize = 0;
+	int fileFD = openStaticFile(filePath, fileSize);
+	if (fileFD < 0) {
 		sendError(404, "Not Found", socketFD, server_config, &request, srv);         
 		return;
 	}
@@ -493,10 +576,13 @@ void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std
 	else if (filePath.find(".js")  != std::string::npos) contentType = "application/javascript";
 	else if (filePath.find(".jpg") != std::string::npos || filePath.find(".jpeg") != std::string::npos) contentType = "image/jpeg";
 	else if (filePath.find(".png") != std::string::npos) contentType = "image/png";
-	// Create HTTP response → Headers + content
+	// Create HTTP response → Headers only, the file range follows (sendfile, no copy)
+	std::ostringstream length;
+	length << fileSize;
 	std::string responseContent = "Content-Type: " + contentType + "\r\n"
-								+ request.connectionHeader(request.isConnectionAlive()) + "\r\n"
-								+ content;
+								+ "Content-Length: " + length.str() + "\r\n"
+								+ request.connectionHeader(request.isConnectionAlive()) + "\r\n";
 	HTTPResponse response("OK", 200, responseContent, socketFD);
-	srv.queueResponse(socketFD, response.getRawResponse()); 
+	srv.queueResponse(socketFD, response); 
+	srv.queueFile(socketFD, fileFD, 0, fileSize);
 }
@@ -19,16 +19,14 @@
 class Server;
 
 
-CGIResult runCGI(const HTTPRequest& request, const std::string& script_path, const std::map<std::string, std::string>& cgi_extensions, const std::string& working_directory);
-std::string serveFile(const std::string& filePath);
+CGIResult runCGI(const HTTPRequest& request, const std::string& script_path, const std::string& executor, const std::string& working_directory, const std::string& server_name, int server_port);
+int openStaticFile(const std::string& filePath, size_t& size);
 std::string generateDirectoryListing(const std::string& dirPath);
 
 //  helper functions
 const ServerConfig* findServerConfig(const HTTPRequest& request, const std::vector<ServerConfig>& servers);
-bool isCGIEnabled(const std::string& path, const ServerConfig* server_config);
-std::map<std::string, std::string> getCGIExtensions(const std::string& path, const ServerConfig* server_config);
 
 // Main  function
-void handleRequestProcessing(const HTTPRequest& request, int socketFD, const std::vector<ServerConfig>& servers, Server& srv);
+void handleRequestProcessing(const HTTPRequest& request, const RouteContext& route, int socketFD, Server& srv);
 
 #endif
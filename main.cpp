@@ -1,4 +1,6 @@
 #include "Server.hpp"
+#include "Master.hpp"
+#include "ReactorPool.hpp"
 #include "config_files/config.hpp"
 #include <iostream>
 #include <cstring>
@@ -31,8 +33,22 @@ int runWithConfig(const std::string& config_file) {
     std::cout << "Port: " << server_config.port << std::endl;
     std::cout << "Document root: " << server_config.root << std::endl;
 
+    // Master/worker mode: the master only supervises, workers serve
+    if (parser.getGlobalConfig().worker_processes > 1) {
+        std::cout << "Workers: " << parser.getGlobalConfig().worker_processes << std::endl;
+        Master master(servers, parser.getGlobalConfig());
+        return master.run();
+    }
+
+    // Threaded mode: acceptor thread + reactor threads sharing this process
+    if (parser.getGlobalConfig().reactor_threads > 0) {
+        std::cout << "Reactor threads: " << parser.getGlobalConfig().reactor_threads << std::endl;
+        ReactorPool pool(servers, parser.getGlobalConfig());
+        return pool.run();
+    }
+
     // Pass server configs to enable multi-server/CGI support
-    Server server(0, server_config.root, servers);
+    Server server(0, server_config.root, servers, parser.getGlobalConfig());
 
     if (!server.start()) {
         return 1;
@@ -270,6 +270,35 @@ if [[ -n "${FNAME:-}" ]]; then
   fi
 fi
 
+# 7.1) Content-Encoding: gzip upload (8080) - stored inflated
+GZ_NAME="gzip_$(date +%s).txt"
+printf -- '--gzb\r\nContent-Disposition: form-data; name="file"; filename="%s"\r\nContent-Type: text/plain\r\n\r\ncompressed upload body\r\n--gzb--\r\n' "$GZ_NAME" \
+  | gzip -c > "${TMP_DIR}/upload.gz"
+code=$(curl_code -X POST -H "Content-Encoding: gzip" -H "Content-Type: multipart/form-data; boundary=gzb" \
+  --data-binary @"${TMP_DIR}/upload.gz" "http://${HOST}:8080/upload/")
+if [[ "$code" == "200" || "$code" == "201" ]] && [[ "$(curl_body "http://${HOST}:8080/upload/${GZ_NAME}")" == "compressed upload body" ]]; then
+  pass "Port 8080: gzip request body inflated before upload"
+else
+  fail "Port 8080: gzip request body (got $code, file content not inflated)"
+fi
+curl -sS -m "${CURL_TIMEOUT}" -o /dev/null -X DELETE "http://${HOST}:8080/upload/${GZ_NAME}" || true
+
+# 7.2) A coding the server cannot undo is refused (8080), passed through with decompress_request_body off (8084)
+code=$(curl_code -X POST -H "Content-Encoding: br" -H "Content-Type: application/octet-stream" --data-binary "xx" "http://${HOST}:8080/upload/")
+if [[ "$code" == "415" ]]; then
+  pass "Port 8080: Unknown Content-Encoding rejected (415)"
+else
+  fail "Port 8080: Unknown Content-Encoding (got $code expected 415)"
+fi
+BR_NAME="passthrough_$(date +%s).txt"
+code=$(curl_code -X POST -H "Content-Encoding: br" -F "file=@${SMALL_FILE};filename=${BR_NAME}" "http://${HOST}:8084/upload/")
+if [[ "$code" == "200" || "$code" == "201" ]]; then
+  pass "Port 8084: decompress_request_body off passes the body through"
+else
+  fail "Port 8084: decompress_request_body off (got $code expected 200/201)"
+fi
+curl -sS -m "${CURL_TIMEOUT}" -o /dev/null -X DELETE "http://${HOST}:8084/upload/${BR_NAME}" || true
+
 # 8) Error Pages - 404 Not Found (8080)
 code=$(curl_code "http://${HOST}:8080/no_such_page_$(date +%s).html")
 if [[ "$code" == "404" ]]; then
@@ -497,6 +526,24 @@ else
   fail "Port 8082: CGI with large input (got $code expected 413)"
 fi
 
+# 8.6.1) Port 8082 - /cgi_bin/ lowers the limit to 64k: 100KB is refused from Content-Length
+MID_POST_FILE="${TMP_DIR}/mid_post.txt"
+dd if=/dev/zero bs=100K count=1 status=none | tr '\0' 'A' > "$MID_POST_FILE"
+code=$(curl_code -X POST -H "Content-Type: application/x-www-form-urlencoded" --data-binary @"$MID_POST_FILE" "http://${HOST}:8082/cgi_bin/hello.py")
+if [[ "$code" == "413" ]]; then
+  pass "Port 8082: Location client_max_body_size override (413)"
+else
+  fail "Port 8082: Location client_max_body_size override (got $code expected 413)"
+fi
+
+# 8.6.2) Port 8082 - A header line longer than large_client_header_buffers' size
+code=$(curl_code -H "X-Big: $(head -c 10000 /dev/zero | tr '\0' 'a')" "http://${HOST}:8082/")
+if [[ "$code" == "431" ]]; then
+  pass "Port 8082: Oversized header line rejected (431)"
+else
+  fail "Port 8082: Oversized header line (got $code expected 431)"
+fi
+
 # 8.7) Port 8082 - Normal CGI request (should work)
 code=$(curl_code "http://${HOST}:8082/cgi_bin/hello.py")
 if [[ "$code" == "200" ]]; then